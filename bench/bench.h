@@ -0,0 +1,108 @@
+#pragma once
+
+#include "bimap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Pieces shared by the benchmarks of the bimap_bench driver. Every
+// benchmark is a function taking the command line settings, registered by
+// name in main.cpp, and prints one line per measured configuration.
+namespace bench
+{
+	struct options
+	{
+		std::size_t pairs = 1000000;
+		std::size_t operations = 1000000;
+		std::size_t threads = 1;
+		std::uint64_t seed = 1;
+	};
+
+	using clock = std::chrono::steady_clock;
+
+	template< typename Splay >
+	using map_t = bimap< unsigned, unsigned, std::less< unsigned >, std::less< unsigned >, Splay >;
+
+	inline double elapsed_ms(clock::time_point since)
+	{
+		return std::chrono::duration< double, std::milli >(clock::now() - since).count();
+	}
+
+	// Keeps the compiler from dropping work whose result is otherwise unused.
+	inline void keep(std::uint64_t value)
+	{
+		static volatile std::uint64_t sink = 0;
+		sink = sink ^ value;
+	}
+
+	// The keys 0 .. count - 1 in random order.
+	inline std::vector< unsigned > shuffled(std::size_t count, std::uint64_t seed)
+	{
+		std::vector< unsigned > keys(count);
+		std::iota(keys.begin(), keys.end(), 0u);
+		std::shuffle(keys.begin(), keys.end(), std::mt19937_64(seed));
+		return keys;
+	}
+
+	// count keys of [0, range). With hot > 0, that share of them is drawn
+	// from a few hot keys by an exponential distribution, the rest uniformly.
+	inline std::vector< unsigned > lookups(std::size_t count, std::size_t range, double hot, std::uint64_t seed)
+	{
+		std::vector< unsigned > order = shuffled(range, seed + 1);
+		std::mt19937_64 rng(seed);
+		std::uniform_real_distribution< double > coin(0, 1);
+		std::exponential_distribution< double > rank(1.0 / std::max< double >(1, static_cast< double >(range) / 10000));
+		std::uniform_int_distribution< std::size_t > uniform(0, range - 1);
+		std::vector< unsigned > keys(count);
+		for (unsigned& key : keys)
+		{
+			std::size_t at = (coin(rng) < hot ? static_cast< std::size_t >(rank(rng)) : uniform(rng));
+			key = order[std::min(at, range - 1)];
+		}
+		return keys;
+	}
+
+	template< typename Map >
+	void fill(Map& map, const std::vector< unsigned >& keys)
+	{
+		for (unsigned key : keys)
+		{
+			map.insert(key, key);
+		}
+	}
+
+	// Latencies of single operations in nanoseconds.
+	struct latencies
+	{
+		std::vector< std::uint64_t > ns;
+
+		void print(const char* name)
+		{
+			std::sort(ns.begin(), ns.end());
+			auto at = [this](double share) { return ns[std::min(ns.size() - 1, static_cast< std::size_t >(share * ns.size()))]; };
+			std::printf("%-20s p50 %6llu  p99 %6llu  p999 %6llu  max %8llu ns\n",
+						name,
+						static_cast< unsigned long long >(at(0.5)),
+						static_cast< unsigned long long >(at(0.99)),
+						static_cast< unsigned long long >(at(0.999)),
+						static_cast< unsigned long long >(ns.back()));
+		}
+	};
+
+	void latency(const options& opt);
+
+	void splay(const options& opt);
+
+	void set_operations(const options& opt);
+
+	void near(const options& opt);
+
+	void layout(const options& opt);
+}	 // namespace bench
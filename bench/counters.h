@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench
+{
+	// Hardware event counts of the calling thread in user space, read with
+	// perf_event_open like perf stat does. Events the kernel or the machine
+	// do not provide, e.g. in most virtual machines, are unavailable.
+	struct counters
+	{
+		enum event
+		{
+			cycles,
+			instructions,
+			cache_misses,
+			l1d_misses,
+			dtlb_misses,
+			events
+		};
+
+		static const char* name(std::size_t e)
+		{
+			static const char* const names[events] = { "cycles", "instructions", "cache-misses", "L1d-misses", "dTLB-misses" };
+			return names[e];
+		}
+
+		counters()
+		{
+#if defined(__linux__)
+			const std::uint32_t types[events] = {
+				PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE
+			};
+			const std::uint64_t configs[events] = {
+				PERF_COUNT_HW_CPU_CYCLES,
+				PERF_COUNT_HW_INSTRUCTIONS,
+				PERF_COUNT_HW_CACHE_MISSES,
+				PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+				PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+			};
+			for (std::size_t e = 0; e < events; e++)
+			{
+				perf_event_attr attr{};
+				attr.size = sizeof(attr);
+				attr.type = types[e];
+				attr.config = configs[e];
+				attr.disabled = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				m_fd[e] = static_cast< int >(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+			}
+#endif
+		}
+
+		counters(const counters&) = delete;
+
+		counters& operator=(const counters&) = delete;
+
+		~counters()
+		{
+#if defined(__linux__)
+			for (int fd : m_fd)
+			{
+				if (fd >= 0)
+				{
+					close(fd);
+				}
+			}
+#endif
+		}
+
+		bool available(std::size_t e) const noexcept { return m_fd[e] >= 0; }
+
+		void start() noexcept
+		{
+#if defined(__linux__)
+			for (int fd : m_fd)
+			{
+				if (fd >= 0)
+				{
+					ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+					ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+				}
+			}
+#endif
+		}
+
+		void stop() noexcept
+		{
+#if defined(__linux__)
+			for (std::size_t e = 0; e < events; e++)
+			{
+				m_value[e] = 0;
+				if (m_fd[e] >= 0)
+				{
+					ioctl(m_fd[e], PERF_EVENT_IOC_DISABLE, 0);
+					if (read(m_fd[e], &m_value[e], sizeof(m_value[e])) != sizeof(m_value[e]))
+					{
+						m_value[e] = 0;
+					}
+				}
+			}
+#endif
+		}
+
+		// The count between the last start() and stop().
+		std::uint64_t value(std::size_t e) const noexcept { return m_value[e]; }
+
+	  private:
+		int m_fd[events] = { -1, -1, -1, -1, -1 };
+		std::uint64_t m_value[events] = {};
+	};
+}	 // namespace bench
@@ -0,0 +1,34 @@
+#include "bench.h"
+
+// Latency distribution of lookups, where most of them hit a few hot keys
+// and the rest land on cold, deep nodes. Full splaying rotates a cold node
+// all the way up, semi and depth-limited splaying bound that work.
+namespace
+{
+	template< typename Splay >
+	void run(const char* name, const bench::options& opt, const std::vector< unsigned >& keys)
+	{
+		bench::map_t< Splay > map;
+		bench::fill(map, bench::shuffled(opt.pairs, opt.seed));
+		bench::latencies lat;
+		lat.ns.reserve(keys.size());
+		for (unsigned key : keys)
+		{
+			bench::clock::time_point start = bench::clock::now();
+			bench::keep(*map.find_left(key).flip());
+			lat.ns.push_back(
+				std::chrono::duration_cast< std::chrono::nanoseconds >(bench::clock::now() - start).count());
+		}
+		lat.print(name);
+	}
+}	 // namespace
+
+void bench::latency(const options& opt)
+{
+	std::vector< unsigned > keys = lookups(opt.operations, opt.pairs, 0.9, opt.seed);
+	run< bimap_splay::bottom_up >("bottom_up", opt, keys);
+	run< bimap_splay::top_down >("top_down", opt, keys);
+	run< bimap_splay::semi >("semi", opt, keys);
+	run< bimap_splay::depth_limited<> >("depth_limited<2>", opt, keys);
+	run< bimap_splay::depth_limited< 4 > >("depth_limited<4>", opt, keys);
+}
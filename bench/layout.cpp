@@ -0,0 +1,57 @@
+#include "bench.h"
+#include "counters.h"
+
+#include <string>
+
+// Uniform lookups before and after compact(), with hardware counters per
+// lookup. Pairs inserted in random order lie in the pool in insertion
+// order, so neighbours in the tree are far apart in memory; compact()
+// places the top levels of the left tree next to each other.
+namespace
+{
+	template< typename Map >
+	void measure(const char* name, Map& map, const std::vector< unsigned >& keys)
+	{
+		bench::counters counters;
+		bench::clock::time_point start = bench::clock::now();
+		counters.start();
+		for (unsigned key : keys)
+		{
+			bench::keep(map.at_left(key));
+		}
+		counters.stop();
+		double ms = bench::elapsed_ms(start);
+
+		std::printf("%-24s %8.1f ms", name, ms);
+		for (std::size_t e = 0; e < bench::counters::events; e++)
+		{
+			if (counters.available(e))
+			{
+				std::printf("  %s %.2f", bench::counters::name(e), static_cast< double >(counters.value(e)) / keys.size());
+			}
+			else
+			{
+				std::printf("  %s n/a", bench::counters::name(e));
+			}
+		}
+		std::printf(" per lookup\n");
+	}
+
+	template< typename Splay >
+	void run(const char* name, const bench::options& opt, const std::vector< unsigned >& keys)
+	{
+		bench::map_t< Splay > map;
+		bench::fill(map, bench::shuffled(opt.pairs, opt.seed));
+		std::string label(name);
+		measure((label + " before").c_str(), map, keys);
+		map.compact();
+		measure((label + " after").c_str(), map, keys);
+	}
+}	 // namespace
+
+void bench::layout(const options& opt)
+{
+	std::vector< unsigned > keys = lookups(opt.operations, opt.pairs, 0, opt.seed);
+	run< bimap_splay::bottom_up >("bottom_up", opt, keys);
+	run< bimap_splay::depth_limited<> >("depth_limited<2>", opt, keys);
+}
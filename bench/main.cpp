@@ -0,0 +1,101 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace
+{
+	struct benchmark
+	{
+		const char* name;
+		const char* description;
+		void (*run)(const bench::options&);
+	};
+
+	const benchmark benchmarks[] = {
+		{ "latency", "p50/p99/p999 lookup latency of the splay strategies on skewed keys", bench::latency },
+		{ "splay", "top-down against bottom-up splaying, uniform, skewed and lookup-heavy", bench::splay },
+		{ "set", "union, intersection and difference of two maps of pairs pairs", bench::set_operations },
+		{ "near", "find against find_near in a sliding window of 64 keys", bench::near },
+		{ "layout", "lookups before and after compact(), with hardware counters", bench::layout },
+	};
+
+	int usage(const char* self)
+	{
+		std::fprintf(stderr,
+					 "usage: %s <benchmark>... [--pairs N] [--operations N] [--threads N] [--seed N]\n\n"
+					 "  all         every benchmark below\n",
+					 self);
+		for (const benchmark& b : benchmarks)
+		{
+			std::fprintf(stderr, "  %-11s %s\n", b.name, b.description);
+		}
+		return 2;
+	}
+}	 // namespace
+
+int main(int argc, char** argv)
+{
+	bench::options opt;
+	std::vector< const benchmark* > chosen;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg.rfind("--", 0) == 0)
+		{
+			if (i + 1 == argc)
+			{
+				return usage(argv[0]);
+			}
+			std::uint64_t value = std::strtoull(argv[++i], nullptr, 10);
+			if (arg == "--pairs")
+			{
+				opt.pairs = value;
+			}
+			else if (arg == "--operations")
+			{
+				opt.operations = value;
+			}
+			else if (arg == "--threads")
+			{
+				opt.threads = value;
+			}
+			else if (arg == "--seed")
+			{
+				opt.seed = value;
+			}
+			else
+			{
+				return usage(argv[0]);
+			}
+			continue;
+		}
+		bool found = false;
+		for (const benchmark& b : benchmarks)
+		{
+			if (arg == "all" || arg == b.name)
+			{
+				chosen.push_back(&b);
+				found = true;
+			}
+		}
+		if (!found)
+		{
+			return usage(argv[0]);
+		}
+	}
+	if (chosen.empty() || !opt.pairs || !opt.operations || !opt.threads)
+	{
+		return usage(argv[0]);
+	}
+
+	std::printf("%zu pairs, %zu operations, %zu threads\n", opt.pairs, opt.operations, opt.threads);
+	for (const benchmark* b : chosen)
+	{
+		std::printf("\n# %s: %s\n", b->name, b->description);
+		b->run(opt);
+	}
+	return 0;
+}
@@ -0,0 +1,105 @@
+#include "bench.h"
+
+#include <string>
+#include <type_traits>
+
+// Lookups in a window of 64 keys that slides over all keys, with find and
+// with find_near from the previous hit, each on its own copy of the same
+// map. The best of three passes is printed. When lookups splay, the
+// previous hit is at or near the root and find_near only adds the climb.
+// With depth_limited the previous hit stays deep and find_near walks
+// about half the links of find, but each step of the climb takes more
+// branches than one of the descent; it pays off once comparisons cost
+// more than the walk, as with the string keys.
+namespace
+{
+	constexpr std::size_t window = 64;
+	constexpr int passes = 3;
+
+	std::string text_key(unsigned key)
+	{
+		std::string digits = std::to_string(key);
+		return "customer/" + std::string(10 - digits.size(), '0') + digits;
+	}
+
+	template< typename Key >
+	Key make_key(unsigned key)
+	{
+		if constexpr (std::is_same_v< Key, std::string >)
+		{
+			return text_key(key);
+		}
+		else
+		{
+			return key;
+		}
+	}
+
+	template< typename Key, typename Splay >
+	void run(const char* name, const bench::options& opt, const std::vector< unsigned >& keys)
+	{
+		using map_t = bimap< Key, unsigned, std::less< Key >, std::less< unsigned >, Splay >;
+		std::vector< Key > lookups;
+		lookups.reserve(keys.size());
+		for (unsigned key : keys)
+		{
+			lookups.push_back(make_key< Key >(key));
+		}
+		map_t by_find;
+		map_t by_near;
+		for (unsigned key : bench::shuffled(opt.pairs, opt.seed))
+		{
+			by_find.insert(make_key< Key >(key), key);
+			by_near.insert(make_key< Key >(key), key);
+		}
+
+		double find_ms = 0;
+		double near_ms = 0;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			bench::clock::time_point start = bench::clock::now();
+			for (const Key& key : lookups)
+			{
+				bench::keep(*by_find.find_left(key).flip());
+			}
+			double ms = bench::elapsed_ms(start);
+			find_ms = (pass ? std::min(find_ms, ms) : ms);
+
+			auto finger = by_near.begin_left();
+			start = bench::clock::now();
+			for (const Key& key : lookups)
+			{
+				finger = by_near.find_left_near(finger, key);
+				bench::keep(*finger.flip());
+			}
+			ms = bench::elapsed_ms(start);
+			near_ms = (pass ? std::min(near_ms, ms) : ms);
+		}
+
+		std::printf("%-26s find %8.1f ms  find_near %8.1f ms\n", name, find_ms, near_ms);
+	}
+
+	template< typename Key >
+	void run_all(const char* key_name, const bench::options& opt, const std::vector< unsigned >& keys)
+	{
+		std::string prefix = std::string(key_name) + " ";
+		run< Key, bimap_splay::bottom_up >((prefix + "bottom_up").c_str(), opt, keys);
+		run< Key, bimap_splay::top_down >((prefix + "top_down").c_str(), opt, keys);
+		run< Key, bimap_splay::semi >((prefix + "semi").c_str(), opt, keys);
+		run< Key, bimap_splay::depth_limited<> >((prefix + "depth_limited<2>").c_str(), opt, keys);
+	}
+}	 // namespace
+
+void bench::near(const options& opt)
+{
+	std::mt19937_64 rng(opt.seed);
+	std::uniform_int_distribution< std::size_t > offset(0, window - 1);
+	std::size_t range = std::max(opt.pairs, window) - window + 1;
+	std::vector< unsigned > keys(opt.operations);
+	for (std::size_t i = 0; i < keys.size(); i++)
+	{
+		keys[i] = static_cast< unsigned >(std::min(opt.pairs - 1, i * range / keys.size() + offset(rng)));
+	}
+	run_all< unsigned >("unsigned", opt, keys);
+	run_all< std::string >("string", opt, keys);
+}
@@ -0,0 +1,63 @@
+#include "bench.h"
+
+#include "bimap_loader.h"
+#include "bimap_set_operations.h"
+
+// Union, intersection and difference of two maps of pairs pairs each, on
+// one thread and on threads threads. a maps 2i to a shuffled right. b maps
+// 3j to the same pair as a for every fourth j, to the right of another
+// pair of a for the next even j, and to a right unused by a otherwise.
+namespace
+{
+	using input_t = bench::map_t< bimap_splay::bottom_up >;
+
+	template< typename Operation >
+	void run(const char* name, const input_t& a, const input_t& b, std::size_t threads, Operation operation)
+	{
+		bench::clock::time_point start = bench::clock::now();
+		input_t res = operation(a, b, threads);
+		double ms = bench::elapsed_ms(start);
+		std::printf("%-12s %2zu threads %9.1f ms  %zu pairs\n", name, threads, ms, res.size());
+	}
+}	 // namespace
+
+void bench::set_operations(const options& opt)
+{
+	std::vector< unsigned > rights = shuffled(opt.pairs, opt.seed);
+	bench::clock::time_point start = bench::clock::now();
+	bimap_loader< unsigned, unsigned > load_a(1 << 16, 1 << 12, opt.threads);
+	bimap_loader< unsigned, unsigned > load_b(1 << 16, 1 << 12, opt.threads);
+	for (std::size_t i = 0; i < opt.pairs; i++)
+	{
+		load_a.push(static_cast< unsigned >(2 * i), rights[i]);
+		std::size_t shared = 3 * i / 2;
+		unsigned right = static_cast< unsigned >(opt.pairs + i);
+		if (i % 2 == 0 && shared + 1 < opt.pairs)
+		{
+			right = rights[i % 4 == 0 ? shared : shared + 1];
+		}
+		load_b.push(static_cast< unsigned >(3 * i), right);
+	}
+	input_t a = load_a.finish();
+	input_t b = load_b.finish();
+	std::printf("inputs built in %.1f ms\n", elapsed_ms(start));
+
+	for (std::size_t threads : { std::size_t(1), opt.threads })
+	{
+		run("union", a, b, threads, [](const input_t& x, const input_t& y, std::size_t t) { return bimap_union(x, y, t); });
+		run("intersection",
+			a,
+			b,
+			threads,
+			[](const input_t& x, const input_t& y, std::size_t t) { return bimap_intersection(x, y, t); });
+		run("difference",
+			a,
+			b,
+			threads,
+			[](const input_t& x, const input_t& y, std::size_t t) { return bimap_difference(x, y, t); });
+		if (opt.threads == 1)
+		{
+			break;
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#include "bench.h"
+
+// Throughput of top-down against bottom-up splaying: uniform and skewed
+// lookups, and a lookup-heavy mix where every twentieth operation replaces
+// a pair.
+namespace
+{
+	template< typename Splay >
+	void run(const char* name, const bench::options& opt)
+	{
+		std::vector< unsigned > uniform = bench::lookups(opt.operations, opt.pairs, 0, opt.seed);
+		std::vector< unsigned > skewed = bench::lookups(opt.operations, opt.pairs, 1, opt.seed);
+		bench::map_t< Splay > map;
+		bench::fill(map, bench::shuffled(opt.pairs, opt.seed));
+
+		auto lookup_all = [&map](const std::vector< unsigned >& keys)
+		{
+			bench::clock::time_point start = bench::clock::now();
+			for (unsigned key : keys)
+			{
+				bench::keep(*map.find_left(key).flip());
+			}
+			return bench::elapsed_ms(start);
+		};
+		double uniform_ms = lookup_all(uniform);
+		double skewed_ms = lookup_all(skewed);
+
+		bench::clock::time_point start = bench::clock::now();
+		for (std::size_t i = 0; i < skewed.size(); i++)
+		{
+			if (i % 20 == 19)
+			{
+				map.erase_left(uniform[i]);
+				map.insert(uniform[i], uniform[i]);
+			}
+			else
+			{
+				bench::keep(*map.find_left(skewed[i]).flip());
+			}
+		}
+		double mixed_ms = bench::elapsed_ms(start);
+
+		double per_op = 1e6 / static_cast< double >(opt.operations);
+		std::printf("%-10s uniform %8.1f ms (%4.0f ns/op)  skewed %8.1f ms (%4.0f ns/op)  mixed %8.1f ms (%4.0f ns/op)\n",
+					name,
+					uniform_ms,
+					uniform_ms * per_op,
+					skewed_ms,
+					skewed_ms * per_op,
+					mixed_ms,
+					mixed_ms * per_op);
+	}
+}	 // namespace
+
+void bench::splay(const options& opt)
+{
+	run< bimap_splay::bottom_up >("bottom_up", opt);
+	run< bimap_splay::top_down >("top_down", opt);
+}
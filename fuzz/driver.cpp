@@ -0,0 +1,108 @@
+#include "harness.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// Runs the harness without a fuzzing engine: over files and directories
+// of inputs, e.g. fuzz/corpus or the crashes a fuzzer wrote, and over
+// --runs random inputs that cycle through every configuration. The time
+// taken is printed, so that a fixed corpus and seed double as a
+// performance regression check.
+namespace
+{
+	int usage(const char* self)
+	{
+		std::fprintf(stderr, "usage: %s [file or directory]... [--runs N] [--seed N] [--max-length N]\n", self);
+		return 2;
+	}
+
+	void run_file(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::vector< std::uint8_t > data((std::istreambuf_iterator< char >(file)), std::istreambuf_iterator< char >());
+		bimap_fuzz::run(data.data(), data.size());
+	}
+}	 // namespace
+
+int main(int argc, char** argv)
+{
+	std::uint64_t runs = 0;
+	std::uint64_t seed = 1;
+	std::uint64_t max_length = 512;
+	std::vector< std::filesystem::path > paths;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg.rfind("--", 0) != 0)
+		{
+			paths.emplace_back(arg);
+			continue;
+		}
+		if (i + 1 == argc)
+		{
+			return usage(argv[0]);
+		}
+		std::uint64_t value = std::strtoull(argv[++i], nullptr, 10);
+		if (arg == "--runs")
+		{
+			runs = value;
+		}
+		else if (arg == "--seed")
+		{
+			seed = value;
+		}
+		else if (arg == "--max-length")
+		{
+			max_length = value;
+		}
+		else
+		{
+			return usage(argv[0]);
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::size_t files = 0;
+	for (const std::filesystem::path& path : paths)
+	{
+		if (!std::filesystem::is_directory(path))
+		{
+			run_file(path);
+			files++;
+			continue;
+		}
+		for (const auto& entry : std::filesystem::directory_iterator(path))
+		{
+			if (entry.is_regular_file())
+			{
+				run_file(entry.path());
+				files++;
+			}
+		}
+	}
+
+	std::mt19937_64 rng(seed);
+	std::uniform_int_distribution< std::uint64_t > length(1, std::max< std::uint64_t >(max_length, 1));
+	std::vector< std::uint8_t > data;
+	for (std::uint64_t r = 0; r < runs; r++)
+	{
+		data.resize(length(rng));
+		for (std::uint8_t& byte : data)
+		{
+			byte = static_cast< std::uint8_t >(rng());
+		}
+		data[0] = static_cast< std::uint8_t >(r % bimap_fuzz::configurations);
+		bimap_fuzz::run(data.data(), data.size());
+	}
+
+	double ms = std::chrono::duration< double, std::milli >(std::chrono::steady_clock::now() - start).count();
+	std::printf("%zu files, %llu random inputs in %.1f ms\n", files, static_cast< unsigned long long >(runs), ms);
+	return 0;
+}
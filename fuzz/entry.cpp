@@ -0,0 +1,8 @@
+#include "harness.h"
+
+// The entry point for libFuzzer and compatible engines.
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+	bimap_fuzz::run(data, size);
+	return 0;
+}
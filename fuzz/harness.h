@@ -0,0 +1,1116 @@
+#pragma once
+
+#include "bimap.h"
+#include "bimap_loader.h"
+#include "bimap_replica.h"
+#include "bimap_set_operations.h"
+#include "bounded_bimap.h"
+#include "multi_bimap.h"
+#include "persistent_bimap.h"
+#include "small_bimap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+// Differential testing of the containers against reference models built
+// from std::map. The first byte of an input picks the container and its
+// policies, the following bytes are read as operations and their keys.
+// After every operation the container is checked against the model in
+// both orders, forwards and backwards, and its invariants are checked. A
+// mismatch aborts with the failed check, for fuzzers and sanitizers to
+// report.
+#define BIMAP_FUZZ_CHECK(condition) ::bimap_fuzz::check((condition), #condition, __LINE__)
+
+namespace bimap_fuzz
+{
+	using key_t = unsigned;
+
+	inline void check(bool ok, const char* what, unsigned line)
+	{
+		if (!ok)
+		{
+			std::fprintf(stderr, "harness.h:%u: check failed: %s\n", line, what);
+			std::abort();
+		}
+	}
+
+	// Reads the input, as zeros past its end.
+	struct input
+	{
+		const std::uint8_t* data;
+		std::size_t size;
+
+		bool done() const noexcept { return !size; }
+
+		std::uint8_t byte() noexcept
+		{
+			if (!size)
+			{
+				return 0;
+			}
+			size--;
+			return *data++;
+		}
+
+		// Keys are few, so that operations often hit existing pairs.
+		key_t key() noexcept { return byte() % 48; }
+	};
+
+	// The pairs of a bimap, by each side.
+	struct model
+	{
+		std::map< key_t, key_t > by_left;
+		std::map< key_t, key_t > by_right;
+
+		bool insert(key_t left, key_t right)
+		{
+			if (by_left.count(left) || by_right.count(right))
+			{
+				return false;
+			}
+			by_left[left] = right;
+			by_right[right] = left;
+			return true;
+		}
+
+		bool erase_left(key_t left)
+		{
+			auto it = by_left.find(left);
+			if (it == by_left.end())
+			{
+				return false;
+			}
+			by_right.erase(it->second);
+			by_left.erase(it);
+			return true;
+		}
+
+		bool erase_right(key_t right)
+		{
+			auto it = by_right.find(right);
+			return it != by_right.end() && erase_left(it->second);
+		}
+
+		// What insert_or_assign leaves: the pairs of left and of right are
+		// replaced by (left, right).
+		void assign(key_t left, key_t right)
+		{
+			erase_left(left);
+			erase_right(right);
+			insert(left, right);
+		}
+	};
+
+	// Walks one side of a container forwards and backwards along the side
+	// of the model, which is a map or a multimap from key to paired key.
+	template< typename Iterator, typename Side >
+	void compare_side(Iterator first, Iterator last, const Side& side)
+	{
+		Iterator it = first;
+		for (const auto& [key, paired] : side)
+		{
+			BIMAP_FUZZ_CHECK(it != last && *it == key && *it.flip() == paired);
+			++it;
+		}
+		BIMAP_FUZZ_CHECK(it == last);
+		for (auto expected = side.rbegin(); expected != side.rend(); ++expected)
+		{
+			--it;
+			BIMAP_FUZZ_CHECK(*it == expected->first);
+		}
+		BIMAP_FUZZ_CHECK(it == first);
+	}
+
+	template< typename Map, typename Model >
+	void compare(const Map& map, const Model& m)
+	{
+		BIMAP_FUZZ_CHECK(map.size() == m.by_left.size());
+		BIMAP_FUZZ_CHECK(map.empty() == m.by_left.empty());
+		compare_side(map.begin_left(), map.end_left(), m.by_left);
+		compare_side(map.begin_right(), map.end_right(), m.by_right);
+	}
+
+	// A found iterator against the side of the model.
+	template< typename Iterator, typename Side >
+	void compare_found(Iterator found, Iterator last, const Side& side, key_t key)
+	{
+		auto expected = side.find(key);
+		BIMAP_FUZZ_CHECK(expected == side.end() ? found == last
+												: (found != last && *found == key && *found.flip() == expected->second));
+	}
+
+	// A bound against the same bound of the side of the model.
+	template< typename Iterator, typename Side >
+	void compare_bound(Iterator found, Iterator last, typename Side::const_iterator expected, const Side& side)
+	{
+		BIMAP_FUZZ_CHECK(expected == side.end() ? found == last : (found != last && *found == expected->first));
+	}
+
+	template< typename Bimap, bool Fingerprinted >
+	void run_bimap(input& in)
+	{
+		Bimap map;
+		model m;
+		// The second operand of set operations.
+		Bimap other;
+		model other_m;
+		while (!in.done())
+		{
+			std::uint8_t op = in.byte();
+			key_t left = in.key();
+			key_t right = in.key();
+			switch (op % 16)
+			{
+			case 0:
+			case 1:
+			{
+				auto it = map.insert(left, right);
+				BIMAP_FUZZ_CHECK(m.insert(left, right) ? it != map.end_left() && *it == left && *it.flip() == right
+													   : it == map.end_left());
+				break;
+			}
+			case 2:
+				BIMAP_FUZZ_CHECK(map.erase_left(left) == m.erase_left(left));
+				break;
+			case 3:
+				BIMAP_FUZZ_CHECK(map.erase_right(right) == m.erase_right(right));
+				break;
+			case 4:
+			{
+				auto it = map.lower_bound_left(left);
+				auto expected = m.by_left.lower_bound(left);
+				compare_bound(it, map.end_left(), expected, m.by_left);
+				if (it != map.end_left())
+				{
+					key_t erased = *it;
+					auto next = map.erase_left(it);
+					m.erase_left(erased);
+					compare_bound(next, map.end_left(), m.by_left.upper_bound(erased), m.by_left);
+				}
+				break;
+			}
+			case 5:
+			{
+				key_t from = std::min(left, right);
+				key_t to = std::max(left, right);
+				map.erase_left(map.lower_bound_left(from), map.lower_bound_left(to));
+				while (m.by_left.lower_bound(from) != m.by_left.lower_bound(to))
+				{
+					m.erase_left(m.by_left.lower_bound(from)->first);
+				}
+				break;
+			}
+			case 6:
+			{
+				compare_found(map.find_left(left), map.end_left(), m.by_left, left);
+				compare_found(map.find_right(right), map.end_right(), m.by_right, right);
+				bool present = m.by_left.count(left);
+				try
+				{
+					key_t found = map.at_left(left);
+					BIMAP_FUZZ_CHECK(present && found == m.by_left[left]);
+				} catch (const std::out_of_range&)
+				{
+					BIMAP_FUZZ_CHECK(!present);
+				}
+				present = m.by_right.count(right);
+				try
+				{
+					key_t found = map.at_right(right);
+					BIMAP_FUZZ_CHECK(present && found == m.by_right[right]);
+				} catch (const std::out_of_range&)
+				{
+					BIMAP_FUZZ_CHECK(!present);
+				}
+				break;
+			}
+			case 7:
+				compare_bound(map.lower_bound_left(left), map.end_left(), m.by_left.lower_bound(left), m.by_left);
+				compare_bound(map.upper_bound_left(left), map.end_left(), m.by_left.upper_bound(left), m.by_left);
+				compare_bound(map.lower_bound_right(right), map.end_right(), m.by_right.lower_bound(right), m.by_right);
+				compare_bound(map.upper_bound_right(right), map.end_right(), m.by_right.upper_bound(right), m.by_right);
+				{
+					key_t from = std::min(left, right);
+					key_t to = std::max(left, right);
+					auto [first, last] = map.subrange_left(from, to);
+					compare_bound(first, map.end_left(), m.by_left.lower_bound(from), m.by_left);
+					compare_bound(last, map.end_left(), m.by_left.upper_bound(to), m.by_left);
+					auto range = map.equal_range_right(right);
+					compare_bound(range.first, map.end_right(), m.by_right.lower_bound(right), m.by_right);
+					compare_bound(range.end(), map.end_right(), m.by_right.upper_bound(right), m.by_right);
+					BIMAP_FUZZ_CHECK(range.empty() == !m.by_right.count(right));
+				}
+				break;
+			case 8:
+			{
+				key_t from = in.key();
+				auto finger_left = map.lower_bound_left(from);
+				if (finger_left != map.end_left())
+				{
+					compare_found(map.find_left_near(finger_left, left), map.end_left(), m.by_left, left);
+				}
+				auto finger_right = map.lower_bound_right(from);
+				if (finger_right != map.end_right())
+				{
+					compare_found(map.find_right_near(finger_right, right), map.end_right(), m.by_right, right);
+				}
+				break;
+			}
+			case 9:
+			{
+				// Gives the pair of left the left right, unless that is used.
+				auto it = map.find_left(left);
+				if (it != map.end_left())
+				{
+					bool taken = left != right && m.by_left.count(right);
+					auto replaced = map.replace_left(it, right);
+					BIMAP_FUZZ_CHECK(taken ? replaced == map.end_left() : (replaced != map.end_left() && *replaced == right));
+					if (!taken)
+					{
+						key_t paired = m.by_left[left];
+						m.erase_left(left);
+						m.insert(right, paired);
+					}
+				}
+				break;
+			}
+			case 10:
+			{
+				auto it = map.find_right(right);
+				if (it != map.end_right())
+				{
+					bool taken = left != right && m.by_right.count(left);
+					auto replaced = map.replace_right(it, left);
+					BIMAP_FUZZ_CHECK(taken ? replaced == map.end_right() : (replaced != map.end_right() && *replaced == left));
+					if (!taken)
+					{
+						key_t paired = m.by_right[right];
+						m.erase_right(right);
+						m.insert(paired, left);
+					}
+				}
+				break;
+			}
+			case 11:
+			{
+				auto it = map.insert_or_assign(left, right);
+				m.assign(left, right);
+				BIMAP_FUZZ_CHECK(it != map.end_left() && *it == left && *it.flip() == right);
+				break;
+			}
+			case 12:
+				if (op & 16)
+				{
+					key_t expected = (m.by_left.count(left) ? m.by_left[left] : 0);
+					BIMAP_FUZZ_CHECK(map.at_left_or_default(left) == expected);
+					m.assign(left, expected);
+				}
+				else
+				{
+					key_t expected = (m.by_right.count(right) ? m.by_right[right] : 0);
+					BIMAP_FUZZ_CHECK(map.at_right_or_default(right) == expected);
+					m.assign(expected, right);
+				}
+				break;
+			case 13:
+			{
+				Bimap copy(map);
+				BIMAP_FUZZ_CHECK(copy.check_invariants() && copy == map);
+				Bimap moved(std::move(copy));
+				compare(moved, m);
+				if (op & 16)
+				{
+					map.swap(other);
+					std::swap(m, other_m);
+				}
+				else
+				{
+					map = moved;
+				}
+				break;
+			}
+			case 14:
+				if (op & 16)
+				{
+					map.compact();
+				}
+				else
+				{
+					map.reserve(left);
+				}
+				break;
+			case 15:
+				if (op & 16)
+				{
+					other.insert(left, right);
+					other_m.insert(left, right);
+					break;
+				}
+				{
+					std::size_t threads = 1 + left % 3;
+					model united = m;
+					model common;
+					model rest;
+					for (const auto& [l, r] : other_m.by_left)
+					{
+						united.insert(l, r);
+					}
+					for (const auto& [l, r] : m.by_left)
+					{
+						bool shared = other_m.by_left.count(l) && other_m.by_left[l] == r;
+						(shared ? common : rest).insert(l, r);
+					}
+					Bimap res = bimap_union(map, other, threads);
+					BIMAP_FUZZ_CHECK(res.check_invariants());
+					compare(res, united);
+					res = bimap_intersection(map, other, threads);
+					BIMAP_FUZZ_CHECK(res.check_invariants());
+					compare(res, common);
+					res = bimap_difference(map, other, threads);
+					BIMAP_FUZZ_CHECK(res.check_invariants());
+					compare(res, rest);
+				}
+				break;
+			}
+			BIMAP_FUZZ_CHECK(map.check_invariants());
+			compare(map, m);
+			if constexpr (Fingerprinted)
+			{
+				Bimap rebuilt;
+				for (const auto& [l, r] : m.by_left)
+				{
+					rebuilt.insert(l, r);
+				}
+				BIMAP_FUZZ_CHECK(map.content_hash() == rebuilt.content_hash() && map == rebuilt);
+			}
+		}
+	}
+
+	// Pairs may repeat either side. Equal keys are ordered by insertion in
+	// multi_bimap and in std::multimap alike.
+	struct multi_model
+	{
+		std::multimap< key_t, key_t > by_left;
+		std::multimap< key_t, key_t > by_right;
+
+		template< typename Side >
+		static typename Side::iterator find(Side& side, key_t key, key_t paired)
+		{
+			auto [first, last] = side.equal_range(key);
+			auto it = std::find_if(first, last, [paired](const auto& p) { return p.second == paired; });
+			return (it == last ? side.end() : it);
+		}
+
+		bool contains(key_t left, key_t right) { return find(by_left, left, right) != by_left.end(); }
+
+		void erase(key_t left, key_t right)
+		{
+			by_left.erase(find(by_left, left, right));
+			by_right.erase(find(by_right, right, left));
+		}
+	};
+
+	template< typename Multi >
+	void run_multi(input& in)
+	{
+		Multi map;
+		multi_model m;
+		while (!in.done())
+		{
+			std::uint8_t op = in.byte();
+			// Fewer keys, so that they repeat.
+			key_t left = in.key() % 12;
+			key_t right = in.key() % 12;
+			switch (op % 8)
+			{
+			case 0:
+			case 1:
+			{
+				bool present = m.contains(left, right);
+				auto it = map.insert(left, right);
+				BIMAP_FUZZ_CHECK(present ? it == map.end_left() : (it != map.end_left() && *it == left && *it.flip() == right));
+				if (!present)
+				{
+					m.by_left.emplace(left, right);
+					m.by_right.emplace(right, left);
+				}
+				break;
+			}
+			case 2:
+			{
+				std::size_t count = m.by_left.count(left);
+				BIMAP_FUZZ_CHECK(map.erase_left(left) == count);
+				while (m.by_left.count(left))
+				{
+					m.erase(left, m.by_left.find(left)->second);
+				}
+				break;
+			}
+			case 3:
+			{
+				std::size_t count = m.by_right.count(right);
+				BIMAP_FUZZ_CHECK(map.erase_right(right) == count);
+				while (m.by_right.count(right))
+				{
+					m.erase(m.by_right.find(right)->second, right);
+				}
+				break;
+			}
+			case 4:
+				BIMAP_FUZZ_CHECK(map.count_left(left) == m.by_left.count(left));
+				BIMAP_FUZZ_CHECK(map.count_right(right) == m.by_right.count(right));
+				BIMAP_FUZZ_CHECK(map.contains(left, right) == m.contains(left, right));
+				break;
+			case 5:
+			{
+				auto it = map.find_left(left);
+				BIMAP_FUZZ_CHECK(m.by_left.count(left) ? (it != map.end_left() && *it == left && m.contains(left, *it.flip()))
+													   : it == map.end_left());
+				break;
+			}
+			case 6:
+			{
+				compare_bound(map.lower_bound_left(left), map.end_left(), m.by_left.lower_bound(left), m.by_left);
+				compare_bound(map.upper_bound_right(right), map.end_right(), m.by_right.upper_bound(right), m.by_right);
+				auto it = map.lower_bound_left(left);
+				if (it != map.end_left())
+				{
+					BIMAP_FUZZ_CHECK(*it.flip() == m.by_left.lower_bound(left)->second);
+					m.erase(*it, *it.flip());
+					map.erase_left(it);
+				}
+				break;
+			}
+			case 7:
+			{
+				// A copy keeps the order of equivalent keys on both sides.
+				Multi copy(map);
+				BIMAP_FUZZ_CHECK(copy.check_invariants());
+				compare(copy, m);
+				Multi moved(std::move(copy));
+				map.swap(moved);
+				moved.swap(map);
+				break;
+			}
+			}
+			BIMAP_FUZZ_CHECK(map.check_invariants());
+			compare(map, m);
+		}
+	}
+
+	// The pairs of a bounded_bimap with their uses. The pair to evict has the
+	// fewest uses, and among those the oldest stamp, which is renewed on
+	// every use. Under lru every pair counts as used once.
+	struct bounded_model : model
+	{
+		struct use
+		{
+			std::size_t uses;
+			std::size_t stamp;
+		};
+
+		std::map< key_t, use > uses;
+		std::size_t clock = 0;
+
+		key_t victim() const
+		{
+			auto lowest = std::min_element(uses.begin(),
+										   uses.end(),
+										   [](const auto& a, const auto& b)
+										   {
+											   return std::make_pair(a.second.uses, a.second.stamp) <
+													  std::make_pair(b.second.uses, b.second.stamp);
+										   });
+			return lowest->first;
+		}
+
+		void touch(key_t left, bool counts_uses)
+		{
+			use& u = uses[left];
+			u.uses += counts_uses;
+			u.stamp = clock++;
+		}
+	};
+
+	template< typename Bounded >
+	void run_bounded(input& in, bool counts_uses)
+	{
+		std::size_t capacity = 1 + in.byte() % 12;
+		Bounded map(capacity);
+		bounded_model m;
+		auto forget = [&m](bool erased, key_t left)
+		{
+			if (erased)
+			{
+				m.uses.erase(left);
+			}
+		};
+		while (!in.done())
+		{
+			std::uint8_t op = in.byte();
+			key_t left = in.key();
+			key_t right = in.key();
+			switch (op % 8)
+			{
+			case 0:
+			case 1:
+			case 2:
+			{
+				bool fits = !m.by_left.count(left) && !m.by_right.count(right);
+				if (fits && m.by_left.size() == capacity)
+				{
+					key_t evicted = m.victim();
+					m.erase_left(evicted);
+					m.uses.erase(evicted);
+				}
+				auto it = map.insert(left, right);
+				BIMAP_FUZZ_CHECK(fits ? (it != map.end_left() && *it == left && *it.flip() == right) : it == map.end_left());
+				if (fits)
+				{
+					m.insert(left, right);
+					m.uses[left] = { 1, m.clock++ };
+				}
+				break;
+			}
+			case 3:
+				BIMAP_FUZZ_CHECK(map.erase_left(left) == m.by_left.count(left));
+				forget(m.erase_left(left), left);
+				break;
+			case 4:
+			{
+				bool present = m.by_right.count(right);
+				key_t paired = (present ? m.by_right[right] : 0);
+				BIMAP_FUZZ_CHECK(map.erase_right(right) == present);
+				forget(m.erase_right(right), paired);
+				break;
+			}
+			case 5:
+				compare_found(map.find_left(left), map.end_left(), m.by_left, left);
+				if (m.by_left.count(left))
+				{
+					m.touch(left, counts_uses);
+				}
+				break;
+			case 6:
+			{
+				bool present = m.by_right.count(right);
+				try
+				{
+					key_t found = map.at_right(right);
+					BIMAP_FUZZ_CHECK(present && found == m.by_right[right]);
+					m.touch(m.by_right[right], counts_uses);
+				} catch (const std::out_of_range&)
+				{
+					BIMAP_FUZZ_CHECK(!present);
+				}
+				break;
+			}
+			case 7:
+				BIMAP_FUZZ_CHECK(map.contains_left(left) == static_cast< bool >(m.by_left.count(left)));
+				BIMAP_FUZZ_CHECK(map.contains_right(right) == static_cast< bool >(m.by_right.count(right)));
+				break;
+			}
+			BIMAP_FUZZ_CHECK(map.check_invariants());
+			compare(map, m);
+			BIMAP_FUZZ_CHECK(m.uses.empty() ? map.victim() == map.end_left() : *map.victim() == m.victim());
+		}
+	}
+
+	template< typename Small >
+	void run_small(input& in, std::size_t inline_pairs)
+	{
+		Small map;
+		model m;
+		bool spilled = false;
+		while (!in.done())
+		{
+			std::uint8_t op = in.byte();
+			key_t left = in.key();
+			key_t right = in.key();
+			switch (op % 8)
+			{
+			case 0:
+			case 1:
+			case 2:
+			{
+				auto it = map.insert(left, right);
+				BIMAP_FUZZ_CHECK(m.insert(left, right) ? it != map.end_left() && *it == left && *it.flip() == right
+													   : it == map.end_left());
+				spilled = spilled || m.by_left.size() > inline_pairs;
+				break;
+			}
+			case 3:
+				BIMAP_FUZZ_CHECK(map.erase_left(left) == m.erase_left(left));
+				break;
+			case 4:
+			{
+				auto it = map.lower_bound_right(right);
+				compare_bound(it, map.end_right(), m.by_right.lower_bound(right), m.by_right);
+				if (it != map.end_right())
+				{
+					m.erase_right(*it);
+					map.erase_right(it);
+				}
+				break;
+			}
+			case 5:
+			{
+				compare_found(map.find_left(left), map.end_left(), m.by_left, left);
+				bool present = m.by_right.count(right);
+				try
+				{
+					key_t found = map.at_right(right);
+					BIMAP_FUZZ_CHECK(present && found == m.by_right[right]);
+				} catch (const std::out_of_range&)
+				{
+					BIMAP_FUZZ_CHECK(!present);
+				}
+				break;
+			}
+			case 6:
+				compare_bound(map.upper_bound_left(left), map.end_left(), m.by_left.upper_bound(left), m.by_left);
+				compare_bound(map.lower_bound_right(right), map.end_right(), m.by_right.lower_bound(right), m.by_right);
+				break;
+			case 7:
+			{
+				Small copy(map);
+				BIMAP_FUZZ_CHECK(copy == map && copy.is_inline() == map.is_inline());
+				Small moved(std::move(copy));
+				map = std::move(moved);
+				break;
+			}
+			}
+			BIMAP_FUZZ_CHECK(map.is_inline() == !spilled);
+			compare(map, m);
+		}
+	}
+
+	// Every pair in a version, walked by each side. Persistent iterators
+	// give the whole pair.
+	template< typename Persistent >
+	void compare_version(const Persistent& map, const model& m)
+	{
+		BIMAP_FUZZ_CHECK(map.size() == m.by_left.size());
+		auto left = map.begin_left();
+		for (const auto& [key, paired] : m.by_left)
+		{
+			BIMAP_FUZZ_CHECK(left != map.end_left() && left->first == key && left->second == paired);
+			++left;
+		}
+		BIMAP_FUZZ_CHECK(left == map.end_left());
+		auto right = map.begin_right();
+		for (const auto& [key, paired] : m.by_right)
+		{
+			BIMAP_FUZZ_CHECK(right != map.end_right() && right->second == key && right->first == paired);
+			++right;
+		}
+		BIMAP_FUZZ_CHECK(right == map.end_right());
+	}
+
+	template< typename Persistent >
+	void run_persistent(input& in)
+	{
+		Persistent map;
+		model m;
+		// Older versions, which later changes must not affect.
+		std::vector< std::pair< Persistent, model > > snapshots;
+		while (!in.done())
+		{
+			std::uint8_t op = in.byte();
+			key_t left = in.key();
+			key_t right = in.key();
+			switch (op % 8)
+			{
+			case 0:
+			case 1:
+			case 2:
+				BIMAP_FUZZ_CHECK(map.insert(left, right) == m.insert(left, right));
+				break;
+			case 3:
+				BIMAP_FUZZ_CHECK(map.erase_left(left) == m.erase_left(left));
+				break;
+			case 4:
+				BIMAP_FUZZ_CHECK(map.erase_right(right) == m.erase_right(right));
+				break;
+			case 5:
+			{
+				bool present = m.by_left.count(left);
+				BIMAP_FUZZ_CHECK(map.contains_left(left) == present);
+				try
+				{
+					key_t found = map.at_left(left);
+					BIMAP_FUZZ_CHECK(present && found == m.by_left[left]);
+				} catch (const std::out_of_range&)
+				{
+					BIMAP_FUZZ_CHECK(!present);
+				}
+				auto found = map.find_right(right);
+				BIMAP_FUZZ_CHECK(m.by_right.count(right) ? (found != map.end_right() && found->first == m.by_right[right])
+														 : found == map.end_right());
+				break;
+			}
+			case 6:
+				if (snapshots.size() == 4)
+				{
+					snapshots.erase(snapshots.begin());
+				}
+				snapshots.emplace_back(map.snapshot(), m);
+				break;
+			case 7:
+				if (!snapshots.empty())
+				{
+					auto& [version, version_m] = snapshots[left % snapshots.size()];
+					map = version;
+					m = version_m;
+				}
+				break;
+			}
+			compare_version(map, m);
+			for (const auto& [version, version_m] : snapshots)
+			{
+				compare_version(version, version_m);
+			}
+		}
+	}
+
+	using pairs_t = std::vector< std::pair< key_t, key_t > >;
+
+	// Pairs in the order they entered the queue of a loader. Producers
+	// push under the lock, so that the order is known.
+	struct arrivals
+	{
+		std::mutex mutex;
+		pairs_t pairs;
+	};
+
+#if defined(__cpp_impl_coroutine)
+	// A coroutine that starts at once and is never awaited.
+	struct detached
+	{
+		struct promise_type
+		{
+			detached get_return_object() noexcept { return {}; }
+
+			std::suspend_never initial_suspend() noexcept { return {}; }
+
+			std::suspend_never final_suspend() noexcept { return {}; }
+
+			void return_void() noexcept {}
+
+			void unhandled_exception() noexcept { std::abort(); }
+		};
+	};
+
+	// The handles a loader passes back, resumed by the producer thread.
+	struct event_loop
+	{
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque< std::coroutine_handle<> > ready;
+		bool done = false;
+
+		void post(std::coroutine_handle<> handle)
+		{
+			// Notified under the lock, the loop may be gone right after.
+			std::lock_guard< std::mutex > lock(mutex);
+			ready.push_back(handle);
+			wake.notify_one();
+		}
+
+		void run()
+		{
+			while (!done)
+			{
+				std::unique_lock< std::mutex > lock(mutex);
+				wake.wait(lock, [this] { return !ready.empty(); });
+				std::coroutine_handle<> handle = ready.front();
+				ready.pop_front();
+				lock.unlock();
+				handle.resume();
+			}
+		}
+	};
+
+	// Holds the arrival lock while suspended, which is fine since the loop
+	// resumes it on the thread that took the lock.
+	template< typename Loader >
+	detached produce_async(Loader& loader, const pairs_t& pairs, arrivals& arrived, event_loop& loop)
+	{
+		for (const auto& pair : pairs)
+		{
+			arrived.mutex.lock();
+			bool queued = co_await loader.async_push(pair, [&loop](std::coroutine_handle<> handle) { loop.post(handle); });
+			arrived.pairs.push_back(pair);
+			arrived.mutex.unlock();
+			BIMAP_FUZZ_CHECK(queued);
+		}
+		loop.done = true;
+	}
+#endif
+
+	// Pairs pushed by several producers must give the bimap of inserting
+	// them one by one in arrival order, with any queue and batch size.
+	template< typename Loader >
+	void run_loader(input& in)
+	{
+		constexpr std::size_t producers = 3;
+		std::size_t capacity = 1 + in.byte() % 8;
+		std::size_t batch = 1 + in.byte() % 8;
+		std::size_t threads = 1 + in.byte() % 3;
+		std::vector< pairs_t > work(producers);
+		while (!in.done())
+		{
+			std::uint8_t producer = in.byte();
+			key_t left = in.key();
+			key_t right = in.key();
+			work[producer % producers].emplace_back(left, right);
+		}
+
+		Loader loader(capacity, batch, threads);
+		arrivals arrived;
+		auto produce = [&loader, &arrived](const pairs_t& pairs)
+		{
+			for (const auto& pair : pairs)
+			{
+				std::lock_guard< std::mutex > lock(arrived.mutex);
+				BIMAP_FUZZ_CHECK(loader.push(pair));
+				arrived.pairs.push_back(pair);
+			}
+		};
+		std::vector< std::thread > running;
+		for (std::size_t p = 0; p < producers; p++)
+		{
+#if defined(__cpp_impl_coroutine)
+			if (p == 0)
+			{
+				running.emplace_back(
+					[&loader, &arrived, &pairs = work[p]]
+					{
+						event_loop loop;
+						produce_async(loader, pairs, arrived, loop);
+						loop.run();
+					});
+				continue;
+			}
+#endif
+			running.emplace_back(produce, std::cref(work[p]));
+		}
+		for (std::thread& t : running)
+		{
+			t.join();
+		}
+
+		auto map = loader.finish();
+		typename Loader::bimap_t expected;
+		for (const auto& [left, right] : arrived.pairs)
+		{
+			expected.insert(left, right);
+		}
+		BIMAP_FUZZ_CHECK(map.check_invariants() && map == expected);
+		BIMAP_FUZZ_CHECK(loader.finish().empty() && !loader.push(0, 0));
+	}
+
+	// What a reader of a replicated_bimap sees, probing every key. Only
+	// probes that all hit one replica, by its version, count as a snapshot.
+	template< typename Reader >
+	bool read_snapshot(Reader& reader, model& seen)
+	{
+		seen = model();
+		reader.contains_left(0);
+		std::uint64_t version = reader.version();
+		for (key_t left = 0; left < 48; left++)
+		{
+			if (reader.contains_left(left))
+			{
+				seen.insert(left, reader.at_left(left));
+			}
+		}
+		return reader.version() == version && reader.size() == seen.by_left.size();
+	}
+
+	// A writer and two reader threads. Every snapshot a reader sees must be
+	// the primary after some prefix of the writes, never a partial one, and
+	// the prefixes a reader sees must not go back. In the end every reader
+	// sees all writes.
+	template< typename Replicated >
+	void run_replica(input& in)
+	{
+		constexpr std::size_t readers = 2;
+		std::size_t batch = 1 + in.byte() % 8;
+		bool failing_group = in.byte() & 1;
+		std::vector< model > states(1);
+		Replicated map(batch, std::chrono::milliseconds(1));
+
+		if (failing_group)
+		{
+			bool thrown = false;
+			try
+			{
+				typename Replicated::group group(map, [] { throw std::runtime_error("on_start"); });
+			} catch (const std::runtime_error&)
+			{
+				thrown = true;
+			}
+			BIMAP_FUZZ_CHECK(thrown);
+		}
+
+		typename Replicated::group group(map);
+		std::atomic< bool > written{ false };
+		std::vector< std::vector< model > > seen(readers);
+		std::vector< std::thread > running;
+		for (std::size_t r = 0; r < readers; r++)
+		{
+			running.emplace_back(
+				[&group, &written, &snapshots = seen[r]]
+				{
+					typename Replicated::reader reader(group);
+					model snapshot;
+					while (!written.load(std::memory_order_acquire))
+					{
+						if (read_snapshot(reader, snapshot))
+						{
+							snapshots.push_back(snapshot);
+						}
+					}
+				});
+		}
+
+		while (!in.done())
+		{
+			std::uint8_t op = in.byte();
+			key_t left = in.key();
+			key_t right = in.key();
+			model m = states.back();
+			switch (op % 4)
+			{
+			case 0:
+				BIMAP_FUZZ_CHECK(map.insert(left, right) == m.insert(left, right));
+				break;
+			case 1:
+				BIMAP_FUZZ_CHECK(map.erase_left(left) == m.erase_left(left));
+				break;
+			case 2:
+				BIMAP_FUZZ_CHECK(map.erase_right(right) == m.erase_right(right));
+				break;
+			case 3:
+				map.insert_or_assign(left, right);
+				m.assign(left, right);
+				break;
+			}
+			states.push_back(std::move(m));
+		}
+		map.publish();
+		written.store(true, std::memory_order_release);
+		for (std::thread& t : running)
+		{
+			t.join();
+		}
+
+		auto same = [](const model& a, const model& b) { return a.by_left == b.by_left && a.by_right == b.by_right; };
+		for (const std::vector< model >& snapshots : seen)
+		{
+			std::size_t prefix = 0;
+			for (const model& snapshot : snapshots)
+			{
+				while (prefix < states.size() && !same(states[prefix], snapshot))
+				{
+					prefix++;
+				}
+				BIMAP_FUZZ_CHECK(prefix < states.size());
+			}
+		}
+
+		typename Replicated::reader reader(group);
+		model last;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (!read_snapshot(reader, last) || !same(last, states.back()))
+		{
+			BIMAP_FUZZ_CHECK(std::chrono::steady_clock::now() < deadline);
+			std::this_thread::yield();
+		}
+	}
+
+	template< typename Splay, typename Fingerprint, typename Iteration >
+	void bimap_with(input& in)
+	{
+		run_bimap< bimap< key_t, key_t, std::less< key_t >, std::less< key_t >, Splay, Fingerprint, Iteration >,
+				   std::is_same_v< Fingerprint, bimap_fingerprint::hashed > >(in);
+	}
+
+	template< typename Splay, typename Iteration >
+	void multi_with(input& in)
+	{
+		run_multi< multi_bimap< key_t, key_t, std::less< key_t >, std::less< key_t >, Splay, Iteration > >(in);
+	}
+
+	template< typename Eviction, typename Splay, typename Iteration >
+	void bounded_with(input& in)
+	{
+		run_bounded< bounded_bimap< key_t, key_t, std::less< key_t >, std::less< key_t >, Eviction, Splay, Iteration > >(
+			in,
+			std::is_same_v< Eviction, bimap_eviction::lfu >);
+	}
+
+	template< std::size_t N >
+	void small_with(input& in)
+	{
+		run_small< small_bimap< key_t, key_t, N > >(in, N);
+	}
+
+	// Every container and policy combination under test, picked by the
+	// first byte of an input.
+	inline void (*const runners[])(input&) = {
+		bimap_with< bimap_splay::bottom_up, bimap_fingerprint::none, bimap_iteration::parent_walk >,
+		bimap_with< bimap_splay::bottom_up, bimap_fingerprint::hashed, bimap_iteration::threaded >,
+		bimap_with< bimap_splay::top_down, bimap_fingerprint::none, bimap_iteration::threaded >,
+		bimap_with< bimap_splay::top_down, bimap_fingerprint::hashed, bimap_iteration::parent_walk >,
+		bimap_with< bimap_splay::semi, bimap_fingerprint::none, bimap_iteration::parent_walk >,
+		bimap_with< bimap_splay::semi, bimap_fingerprint::hashed, bimap_iteration::threaded >,
+		bimap_with< bimap_splay::depth_limited< 1 >, bimap_fingerprint::none, bimap_iteration::threaded >,
+		bimap_with< bimap_splay::depth_limited< 2 >, bimap_fingerprint::hashed, bimap_iteration::parent_walk >,
+		multi_with< bimap_splay::bottom_up, bimap_iteration::parent_walk >,
+		multi_with< bimap_splay::top_down, bimap_iteration::threaded >,
+		multi_with< bimap_splay::depth_limited< 1 >, bimap_iteration::parent_walk >,
+		bounded_with< bimap_eviction::lru, bimap_splay::bottom_up, bimap_iteration::parent_walk >,
+		bounded_with< bimap_eviction::lfu, bimap_splay::bottom_up, bimap_iteration::threaded >,
+		bounded_with< bimap_eviction::lru, bimap_splay::semi, bimap_iteration::threaded >,
+		bounded_with< bimap_eviction::lfu, bimap_splay::top_down, bimap_iteration::parent_walk >,
+		small_with< 1 >,
+		small_with< 4 >,
+		run_persistent< persistent_bimap< key_t, key_t > >,
+		run_loader< bimap_loader< key_t, key_t > >,
+		run_loader< bimap_loader< key_t,
+								  key_t,
+								  std::less< key_t >,
+								  std::less< key_t >,
+								  bimap_splay::semi,
+								  bimap_fingerprint::hashed,
+								  bimap_iteration::threaded > >,
+		run_replica< replicated_bimap< key_t, key_t > >,
+	};
+
+	constexpr std::size_t configurations = sizeof(runners) / sizeof(runners[0]);
+
+	inline void run(const std::uint8_t* data, std::size_t size)
+	{
+		input in{ data, size };
+		runners[in.byte() % configurations](in);
+	}
+}	 // namespace bimap_fuzz
@@ -0,0 +1,53 @@
+#include "static_bimap.h"
+
+#include <string_view>
+
+// Lookups of static_bimap in constant expressions, so building this is
+// the test. With BIMAP_DUPLICATE_LEFT or BIMAP_DUPLICATE_RIGHT defined the
+// construction must be rejected at compile time.
+namespace
+{
+	using namespace std::string_view_literals;
+
+	constexpr static_bimap< int, std::string_view, 4 > ports({ { 443, "https"sv },
+															   { 22, "ssh"sv },
+															   { 80, "http"sv },
+#if defined(BIMAP_DUPLICATE_LEFT)
+															   { 22, "sftp"sv } });
+#elif defined(BIMAP_DUPLICATE_RIGHT)
+															   { 8080, "http"sv } });
+#else
+															   { 25, "smtp"sv } });
+#endif
+
+	static_assert(ports.size() == 4 && !ports.empty());
+	static_assert(ports.at_left(22) == "ssh"sv && ports.at_left(443) == "https"sv);
+	static_assert(ports.at_right("http"sv) == 80 && ports.at_right("smtp"sv) == 25);
+	static_assert(ports.contains_left(80) && !ports.contains_left(8080));
+	static_assert(ports.contains_right("https"sv) && !ports.contains_right("ftp"sv));
+	static_assert(ports.find_left(21) == ports.end() && ports.find_right("ftp"sv) == ports.end());
+	static_assert(ports.find_right("ssh"sv)->first == 22 && ports.find_left(25)->second == "smtp"sv);
+
+	constexpr bool sorted_by_left()
+	{
+		for (auto it = ports.begin(); it + 1 != ports.end(); ++it)
+		{
+			if (!(it->first < (it + 1)->first))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static_assert(sorted_by_left());
+
+	constexpr static_bimap< char, int, 1 > single({ { 'a', 1 } });
+
+	static_assert(single.at_left('a') == 1 && single.at_right(1) == 'a' && !single.contains_left('b'));
+}	 // namespace
+
+int main()
+{
+	return 0;
+}
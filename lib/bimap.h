@@ -1,82 +1,272 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <stdexcept>
 #include <utility>
+#include <vector>
 
-template< typename Lt, typename Rt, typename CLt, typename CRt >
+template< typename Lt, typename Rt, typename CLt, typename CRt, typename Sp, typename Fp, typename It >
 struct bimap;
 
-#include "bimap_element.h"
-#include "bimap_iterator.h"
-#include "bimap_tree.h"
+template< typename Lt, typename Rt, typename CLt, typename CRt, typename Sp, typename It >
+struct multi_bimap;
 
-template< typename Left, typename Right, typename CompareLeft = std::less< Left >, typename CompareRight = std::less< Right > >
-struct bimap
+template< typename Lt, typename Rt, typename CLt, typename CRt, typename Sp, typename Fp, typename It >
+struct bimap_loader;
+
+template< typename Lt, typename Rt, typename CLt, typename CRt, typename Ev, typename Sp, typename It >
+struct bounded_bimap;
+
+namespace bimap_details
+{
+	template< typename Bimap >
+	struct set_merge;
+}	 // namespace bimap_details
+
+#include "bimap_base.h"
+#include "bimap_hash.h"
+
+template< typename Left,
+		  typename Right,
+		  typename CompareLeft = std::less< Left >,
+		  typename CompareRight = std::less< Right >,
+		  typename Splay = bimap_splay::bottom_up,
+		  typename Fingerprint = bimap_fingerprint::none,
+		  typename Iteration = bimap_iteration::parent_walk >
+struct bimap :
+	bimap_details::bimap_base< bimap< Left, Right, CompareLeft, CompareRight, Splay, Fingerprint, Iteration >,
+							   Left,
+							   Right,
+							   CompareLeft,
+							   CompareRight,
+							   Splay,
+							   Iteration >,
+	private bimap_details::fingerprint_holder< std::is_same_v< Fingerprint, bimap_fingerprint::hashed > >
 {
+  private:
+	using base = bimap_details::bimap_base< bimap, Left, Right, CompareLeft, CompareRight, Splay, Iteration >;
+
   public:
-	using left_t = Left;
-	using right_t = Right;
+	using typename base::left_t;
+	using typename base::right_t;
+	using typename base::left_iterator;
+	using typename base::right_iterator;
 
-	using left_iterator = bimap_details::base_iterator< left_t, right_t, true >;
-	using right_iterator = bimap_details::base_iterator< left_t, right_t, false >;
+	using left_range = bimap_details::iterator_range< left_iterator >;
+	using right_range = bimap_details::iterator_range< right_iterator >;
 
   private:
-	using base_t = bimap_details::element_base;
-	using data_t = bimap_details::element_data< left_t, right_t >;
-	using value_left_t = bimap_details::element_value< true, left_t >;
-	using value_right_t = bimap_details::element_value< false, right_t >;
-
-	std::size_t m_count;
-	bimap_details::tree< left_t, true, CompareLeft > m_left_tree;
-	bimap_details::tree< right_t, false, CompareRight > m_right_tree;
+	using typename base::base_t;
+	using typename base::data_t;
+	using typename base::left_position;
+	using typename base::right_position;
+
+	using base::m_count;
+	using base::m_pool;
+	using base::m_left_tree;
+	using base::m_right_tree;
+
+	using base::as_left;
+	using base::as_right;
+	using base::pair_of_left;
+	using base::pair_of_right;
+	using base::left_of;
+	using base::right_of;
+	using base::clear;
+
+	static constexpr bool fingerprinted = std::is_same_v< Fingerprint, bimap_fingerprint::hashed >;
+
+	static_assert(std::is_same_v< Fingerprint, bimap_fingerprint::none > || fingerprinted, "Unknown fingerprint tag");
+	static_assert(!fingerprinted || bimap_details::has_fingerprint< Left, Right, CompareLeft, CompareRight >,
+				  "bimap_fingerprint::hashed requires hashable sides compared by std::less");
+
+	// Contribution of a pair to the fingerprint.
+	static std::uint64_t hash_of(base_t* left, base_t* right) noexcept
+	{
+		if constexpr (fingerprinted)
+		{
+			return bimap_details::pair_hash(left_of(left), right_of(right));
+		}
+		else
+		{
+			return 0;
+		}
+	}
 
+	// One descent per tree: the positions found while checking for
+	// duplicates are used to link the new node.
 	template< typename left_t_f = left_t, typename right_t_f = right_t >
 	left_iterator insert_impl(left_t_f&& left, right_t_f&& right)
 	{
-		if (find_left(left) != end_left() || find_right(right) != end_right())
+		left_position left_pos;
+		right_position right_pos;
+		if (m_left_tree.locate(left, left_pos) || m_right_tree.locate(right, right_pos))
 		{
 			return end_left();
 		}
+		data_t* elem = m_pool.create(std::forward< left_t_f >(left), std::forward< right_t_f >(right));
 		m_count++;
-		data_t* elem = new data_t(std::forward< left_t_f >(left), std::forward< right_t_f >(right));
-		base_t* inserted = m_left_tree.insert(static_cast< base_t* >(static_cast< value_left_t* >(elem)));
-		m_right_tree.insert(static_cast< base_t* >(static_cast< value_right_t* >(elem)));
-		return left_iterator(inserted);
+		this->add_to_fingerprint(hash_of(as_left(elem), as_right(elem)));
+		m_left_tree.attach(as_left(elem), left_pos);
+		m_right_tree.attach(as_right(elem), right_pos);
+		return left_iterator(as_left(elem));
 	}
 
 	void erase_impl(base_t* left_to_delete, base_t* right_to_delete) noexcept
 	{
 		m_count--;
+		this->add_to_fingerprint(-hash_of(left_to_delete, right_to_delete));
 		m_left_tree.erase(left_to_delete);
 		m_right_tree.erase(right_to_delete);
-		delete static_cast< data_t* >(static_cast< value_left_t* >(left_to_delete));
+		m_pool.destroy(base::node_of_left(left_to_delete));
+	}
+
+	// Gives the pair of left and right a new left, the node is moved within
+	// the left tree only. Returns false if another pair has such left.
+	// The key is assigned before the node is moved, so a throwing assignment
+	// leaves the node where it was; move_to makes no comparisons.
+	template< typename left_t_f >
+	bool replace_left_impl(base_t* left, base_t* right, left_t_f&& key)
+	{
+		left_t replacement(std::forward< left_t_f >(key));
+		left_position pos;
+		bool moves = !m_left_tree.is_equals(left_of(left), replacement);
+		if (moves && m_left_tree.locate(replacement, pos))
+		{
+			return false;
+		}
+		std::uint64_t previous = hash_of(left, right);
+		left_of(left) = std::move(replacement);
+		if (moves)
+		{
+			m_left_tree.move_to(left, pos);
+		}
+		this->add_to_fingerprint(hash_of(left, right) - previous);
+		return true;
+	}
+
+	template< typename right_t_f >
+	bool replace_right_impl(base_t* left, base_t* right, right_t_f&& key)
+	{
+		right_t replacement(std::forward< right_t_f >(key));
+		right_position pos;
+		bool moves = !m_right_tree.is_equals(right_of(right), replacement);
+		if (moves && m_right_tree.locate(replacement, pos))
+		{
+			return false;
+		}
+		std::uint64_t previous = hash_of(left, right);
+		right_of(right) = std::move(replacement);
+		if (moves)
+		{
+			m_right_tree.move_to(right, pos);
+		}
+		this->add_to_fingerprint(hash_of(left, right) - previous);
+		return true;
+	}
+
+	// Like in replace_left_impl, keys are assigned before nodes are relinked.
+	template< typename left_t_f, typename right_t_f >
+	left_iterator insert_or_assign_impl(left_t_f&& left, right_t_f&& right)
+	{
+		left_position left_pos;
+		right_position right_pos;
+		base_t* found_left = m_left_tree.locate(left, left_pos);
+		base_t* found_right = m_right_tree.locate(right, right_pos);
+		if (!found_left && !found_right)
+		{
+			data_t* elem = m_pool.create(std::forward< left_t_f >(left), std::forward< right_t_f >(right));
+			m_count++;
+			this->add_to_fingerprint(hash_of(as_left(elem), as_right(elem)));
+			m_left_tree.attach(as_left(elem), left_pos);
+			m_right_tree.attach(as_right(elem), right_pos);
+			return left_iterator(as_left(elem));
+		}
+		if (!found_left)
+		{
+			// Only right is taken, its pair gets the new left.
+			base_t* paired = pair_of_right(found_right);
+			left_t replacement(std::forward< left_t_f >(left));
+			std::uint64_t previous = hash_of(paired, found_right);
+			left_of(paired) = std::move(replacement);
+			m_left_tree.move_to(paired, left_pos);
+			this->add_to_fingerprint(hash_of(paired, found_right) - previous);
+			return left_iterator(paired);
+		}
+		base_t* paired = pair_of_left(found_left);
+		if (paired == found_right)
+		{
+			return left_iterator(found_left);
+		}
+		right_t replacement(std::forward< right_t_f >(right));
+		std::uint64_t previous = hash_of(found_left, paired);
+		right_of(paired) = std::move(replacement);
+		this->add_to_fingerprint(-previous);
+		if (!found_right)
+		{
+			// Only left is taken, its pair gets the new right.
+			m_right_tree.move_to(paired, right_pos);
+		}
+		else
+		{
+			// Both are taken by different pairs: the pair of left takes the
+			// place of the pair of right, which is dropped.
+			base_t* dropped = pair_of_right(found_right);
+			m_right_tree.take_place(paired, found_right);
+			m_left_tree.erase(dropped);
+			m_count--;
+			this->add_to_fingerprint(-hash_of(dropped, found_right));
+			m_pool.destroy(base::node_of_left(dropped));
+		}
+		this->add_to_fingerprint(hash_of(found_left, paired));
+		return left_iterator(found_left);
 	}
 
-	void clear() noexcept { erase_left(begin_left(), end_left()); }
+	template< typename FLt, typename FRt, typename FCLt, typename FCRt, typename FSp, typename FFp, typename FIt >
+	friend struct bimap_loader;
+
+	friend struct bimap_details::set_merge< bimap >;
+
+	// The bulk linking of the base, which also adds the pairs to the
+	// fingerprint.
+	void link_sorted(const std::vector< data_t* >& by_left, const std::vector< data_t* >& by_right)
+	{
+		base::link_sorted(by_left, by_right);
+		if constexpr (fingerprinted)
+		{
+			for (data_t* node : by_left)
+			{
+				this->add_to_fingerprint(hash_of(as_left(node), as_right(node)));
+			}
+		}
+	}
 
   public:
+	using base::erase_left;
+	using base::erase_right;
+	using base::begin_left;
+	using base::end_left;
+	using base::begin_right;
+	using base::end_right;
+	using base::empty;
+	using base::size;
+
 	void swap(bimap& other) noexcept
 	{
-		std::swap(m_count, other.m_count);
-		m_left_tree.swap(other.m_left_tree);
-		m_right_tree.swap(other.m_right_tree);
+		base::swap(other);
+		this->swap_fingerprint(other);
 	}
 
 	// Creates a bimap that does not contain any pairs.
 	bimap(CompareLeft compare_left = CompareLeft(), CompareRight compare_right = CompareRight()) :
-		m_count(0), m_left_tree(std::move(compare_left)), m_right_tree(std::move(compare_right))
+		base(std::move(compare_left), std::move(compare_right))
 	{
-		m_left_tree.set_another_tree(m_right_tree.end());
-		m_right_tree.set_another_tree(m_left_tree.end());
 	}
 
-	bimap(const bimap& other) :
-		m_count(0), m_left_tree(other.m_left_tree.get_comparator()), m_right_tree(other.m_right_tree.get_comparator())
+	bimap(const bimap& other) : base(other)
 	{
-		m_left_tree.set_another_tree(m_right_tree.end());
-		m_right_tree.set_another_tree(m_left_tree.end());
 		try
 		{
 			for (left_iterator it = other.begin_left(); it != other.end_left(); it++)
@@ -90,10 +280,7 @@ struct bimap
 		}
 	}
 
-	bimap(bimap&& other) noexcept :
-		m_count(other.m_count), m_left_tree(std::move(other.m_left_tree)), m_right_tree(std::move(other.m_right_tree))
-	{
-	}
+	bimap(bimap&& other) noexcept : base(std::move(other)) { this->swap_fingerprint(other); }
 
 	bimap& operator=(const bimap& other)
 	{
@@ -177,22 +364,49 @@ struct bimap
 		}
 	}
 
-	// erase from range, removes [first, last), returns an iterator to the last
-	// element after the deleted sequence.
-	left_iterator erase_left(left_iterator first, left_iterator last) noexcept
+	// Changes the left element of the pair it refers to, moving the pair
+	// within the left tree only and reusing its node. Returns an iterator to
+	// the pair, or end_left() if another pair already has such left, in which
+	// case nothing changes. Iterators to the pair stay valid.
+	left_iterator replace_left(left_iterator it, const left_t& left)
 	{
-		for (left_iterator it(first); it != last; it = erase_left(it))
-		{
-		}
-		return last;
+		return (replace_left_impl(it.value, it.flip().value, left) ? it : end_left());
 	}
 
-	right_iterator erase_right(right_iterator first, right_iterator last) noexcept
+	left_iterator replace_left(left_iterator it, left_t&& left)
 	{
-		for (right_iterator it(first); it != last; it = erase_right(it))
-		{
-		}
-		return last;
+		return (replace_left_impl(it.value, it.flip().value, std::move(left)) ? it : end_left());
+	}
+
+	right_iterator replace_right(right_iterator it, const right_t& right)
+	{
+		return (replace_right_impl(it.flip().value, it.value, right) ? it : end_right());
+	}
+
+	right_iterator replace_right(right_iterator it, right_t&& right)
+	{
+		return (replace_right_impl(it.flip().value, it.value, std::move(right)) ? it : end_right());
+	}
+
+	// Makes (left, right) a pair of the bimap, with one descent per tree.
+	// An existing pair with such left or right is reused and repositioned;
+	// if left and right belong to two different pairs, the pair of right is
+	// removed. Returns an iterator to left.
+	left_iterator insert_or_assign(const left_t& left, const right_t& right) { return insert_or_assign_impl(left, right); }
+
+	left_iterator insert_or_assign(const left_t& left, right_t&& right)
+	{
+		return insert_or_assign_impl(left, std::move(right));
+	}
+
+	left_iterator insert_or_assign(left_t&& left, const right_t& right)
+	{
+		return insert_or_assign_impl(std::move(left), right);
+	}
+
+	left_iterator insert_or_assign(left_t&& left, right_t&& right)
+	{
+		return insert_or_assign_impl(std::move(left), std::move(right));
 	}
 
 	// Returns an iterator over the element. If not found, the corresponding end().
@@ -222,6 +436,23 @@ struct bimap
 		}
 	}
 
+	// Same as find, but the search starts from finger and climbs only as far
+	// as the key needs. It saves comparisons when the key is close to a deep
+	// finger, as under depth_limited, and only pays off when they are
+	// expensive. The walk may still be long on an unbalanced tree. finger
+	// may be end().
+	left_iterator find_left_near(left_iterator finger, const left_t& left) const noexcept
+	{
+		base_t* found = m_left_tree.find_near(finger.value, left);
+		return (found ? left_iterator(found) : end_left());
+	}
+
+	right_iterator find_right_near(right_iterator finger, const right_t& right) const noexcept
+	{
+		base_t* found = m_right_tree.find_near(finger.value, right);
+		return (found ? right_iterator(found) : end_right());
+	}
+
 	// Returns the opposite element by element.
 	// If the element does not exist, throws std::out_of_range.
 	const right_t& at_left(const left_t& key) const
@@ -263,13 +494,7 @@ struct bimap
 		{
 			return *found_left.flip();
 		}
-		right_t default_element{};
-		right_iterator found_right = find_right(default_element);
-		if (found_right != end_right())
-		{
-			erase_right(found_right);
-		}
-		return *(insert(key, std::move(default_element)).flip());
+		return *(insert_or_assign(key, right_t{}).flip());
 	}
 
 	template< typename = std::is_default_constructible< Left > >
@@ -280,13 +505,7 @@ struct bimap
 		{
 			return *found_right.flip();
 		}
-		left_t default_element{};
-		left_iterator found_left = find_left(default_element);
-		if (found_left != end_left())
-		{
-			erase_left(found_left);
-		}
-		return *insert(std::move(default_element), key);
+		return *(insert_or_assign(left_t{}, key));
 	}
 
 	// lower and upper bounds on each side.
@@ -306,25 +525,155 @@ struct bimap
 		return right_iterator(m_right_tree.prev(right));
 	}
 
-	// Returns an iterator to the minimum order left.
-	left_iterator begin_left() const noexcept { return left_iterator(m_left_tree.begin()); }
+	// Elements equivalent to the key, that is, at most one element.
+	left_range equal_range_left(const left_t& left) const noexcept { return subrange_left(left, left); }
+
+	right_range equal_range_right(const right_t& right) const noexcept { return subrange_right(right, right); }
+
+	// Elements in the closed interval [from, to], both bounds are found in a
+	// single descent. If to < from the range is empty.
+	left_range subrange_left(const left_t& from, const left_t& to) const noexcept
+	{
+		if (m_left_tree.is_less(to, from))
+		{
+			return left_range(end_left(), end_left());
+		}
+		base_t* first;
+		base_t* last;
+		m_left_tree.bounds(from, to, first, last);
+		return left_range(left_iterator(first), left_iterator(last));
+	}
+
+	right_range subrange_right(const right_t& from, const right_t& to) const noexcept
+	{
+		if (m_right_tree.is_less(to, from))
+		{
+			return right_range(end_right(), end_right());
+		}
+		base_t* first;
+		base_t* last;
+		m_right_tree.bounds(from, to, first, last);
+		return right_range(right_iterator(first), right_iterator(last));
+	}
+
+#if __cplusplus >= 202002L
+	// Lazy views over each side in its order.
+	left_range left_view() const noexcept { return left_range(begin_left(), end_left()); }
+
+	right_range right_view() const noexcept { return right_range(begin_right(), end_right()); }
+
+	// Lazy view of (left, right) pairs of references ordered by left.
+	auto pairs() const noexcept
+	{
+		return std::views::iota(begin_left(), end_left()) |
+			   std::views::transform([](left_iterator it)
+									 { return std::pair< const left_t&, const right_t& >(*it, *it.flip()); });
+	}
+#endif
+
+	// Allocates room for count more pairs up front, so that inserting them
+	// does not allocate. Does not invalidate iterators.
+	void reserve(std::size_t count) { m_pool.reserve(count); }
+
+	// Reallocates all pairs into one contiguous block, in breadth-first
+	// order of a perfectly balanced left tree, and links both trees
+	// perfectly balanced. Meant for a bimap that is about to be mostly read:
+	// lookups keep splaying and gradually undo the layout.
+	// Invalidates all iterators. Elements are moved if that cannot throw and
+	// copied otherwise; if a copy throws, the bimap is left unchanged.
+	void compact()
+	{
+		using left_tree_t = typename base::left_tree_t;
+
+		std::vector< base_t* > by_left;
+		std::vector< base_t* > by_right;
+		std::vector< data_t* > fresh(m_count);
+		std::vector< std::size_t > order = left_tree_t::breadth_first(m_count);
+		by_left.reserve(m_count);
+		by_right.reserve(m_count);
+		for (left_iterator it = begin_left(); it != end_left(); ++it)
+		{
+			by_left.push_back(it.value);
+		}
+		for (right_iterator it = begin_right(); it != end_right(); ++it)
+		{
+			by_right.push_back(it.value);
+		}
+
+		bimap_details::node_pool< data_t > pool;
+		pool.reserve(m_count);
+		std::size_t created = 0;
+		try
+		{
+			for (; created < m_count; created++)
+			{
+				base_t* old = by_left[order[created]];
+				fresh[order[created]] =
+					pool.create(std::move_if_noexcept(left_of(old)), std::move_if_noexcept(right_of(pair_of_left(old))));
+			}
+		} catch (...)
+		{
+			for (std::size_t i = 0; i < created; i++)
+			{
+				pool.destroy(fresh[order[i]]);
+			}
+			throw;
+		}
 
-	left_iterator end_left() const noexcept { return left_iterator(m_left_tree.end()); }
+		// The old left links are not needed anymore and remember new nodes.
+		for (std::size_t i = 0; i < m_count; i++)
+		{
+			by_left[i]->parent = as_left(fresh[i]);
+		}
+		for (std::size_t i = 0; i < m_count; i++)
+		{
+			by_right[i] = as_right(base::node_of_left(pair_of_right(by_right[i])->parent));
+		}
+		for (std::size_t i = 0; i < m_count; i++)
+		{
+			m_pool.destroy(base::node_of_left(by_left[i]));
+			by_left[i] = as_left(fresh[i]);
+		}
+		m_pool.swap(pool);
+		m_left_tree.assign_sorted(by_left.data(), m_count);
+		m_right_tree.assign_sorted(by_right.data(), m_count);
+	}
 
-	// Returns an iterator to the minimum order of right.
-	right_iterator begin_right() const noexcept { return right_iterator(m_right_tree.begin()); }
+	// Copies of the comparators of each side.
+	CompareLeft key_comp_left() const { return m_left_tree.get_comparator(); }
 
-	right_iterator end_right() const noexcept { return right_iterator(m_right_tree.end()); }
+	CompareRight key_comp_right() const { return m_right_tree.get_comparator(); }
 
-	// Check for emptiness.
-	bool empty() const noexcept { return !m_count; }
+	// Checks both trees, that every pair is reachable from both sides and
+	// that the size and the fingerprint match the pairs. Linear-logarithmic
+	// and does not splay, meant for debugging and randomized testing.
+	bool check_invariants() const noexcept
+	{
+		if (!base::check_links(true))
+		{
+			return false;
+		}
+		std::uint64_t sum = 0;
+		for (base_t* left = m_left_tree.leftmost(); left != m_left_tree.end(); left = left->next(left))
+		{
+			sum += hash_of(left, pair_of_left(left));
+		}
+		return sum == this->fingerprint();
+	}
 
-	// Returns the size of the bimap (number of pairs).
-	std::size_t size() const noexcept { return m_count; }
+	// Order-independent hash of the pairs, kept up to date by every
+	// modification. Available with bimap_fingerprint::hashed.
+	std::size_t content_hash() const noexcept
+	{
+		static_assert(fingerprinted, "content_hash() requires bimap_fingerprint::hashed");
+		return static_cast< std::size_t >(bimap_details::mix(this->fingerprint() ^ m_count));
+	}
 
+	// With bimap_fingerprint::hashed, maps with different fingerprints are
+	// told apart in O(1) and the pairs are compared only when they match.
 	friend bool operator==(const bimap& a, const bimap& b) noexcept
 	{
-		if (a.m_count != b.m_count)
+		if (a.m_count != b.m_count || a.fingerprint() != b.fingerprint())
 		{
 			return false;
 		}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "bimap_element.h"
+#include "bimap_iteration.h"
+#include "bimap_iterator.h"
+#include "bimap_pool.h"
+#include "bimap_splay.h"
+#include "bimap_tree.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace bimap_details
+{
+	// What the containers linking every pair into a tree of lefts and a tree
+	// of rights have in common: the count, the node pool and the trees, their
+	// construction, swapping and iteration. Derived provides erase_left(it)
+	// and erase_right(it), which range erasure and clear go through, copies
+	// the pairs in its copy constructor and clears in its destructor.
+	template< typename Derived,
+			  typename Left,
+			  typename Right,
+			  typename CompareLeft,
+			  typename CompareRight,
+			  typename Splay,
+			  typename Iteration,
+			  typename Node = element_data< Left, Right, Iteration > >
+	struct bimap_base
+	{
+	  public:
+		using left_t = Left;
+		using right_t = Right;
+
+		using left_iterator = base_iterator< left_t, right_t, true, Iteration >;
+		using right_iterator = base_iterator< left_t, right_t, false, Iteration >;
+
+	  protected:
+		using base_t = element_base;
+		using data_t = element_data< left_t, right_t, Iteration >;
+		using value_left_t = element_value< true, left_t, Iteration >;
+		using value_right_t = element_value< false, right_t, Iteration >;
+		using left_tree_t = tree< left_t, true, CompareLeft, Splay, Iteration >;
+		using right_tree_t = tree< right_t, false, CompareRight, Splay, Iteration >;
+		using left_position = typename left_tree_t::position;
+		using right_position = typename right_tree_t::position;
+
+		std::size_t m_count = 0;
+		node_pool< Node > m_pool;
+		left_tree_t m_left_tree;
+		right_tree_t m_right_tree;
+
+		static base_t* as_left(Node* elem) noexcept { return static_cast< base_t* >(static_cast< value_left_t* >(elem)); }
+
+		static base_t* as_right(Node* elem) noexcept { return static_cast< base_t* >(static_cast< value_right_t* >(elem)); }
+
+		static Node* node_of_left(base_t* left) noexcept
+		{
+			return static_cast< Node* >(static_cast< data_t* >(static_cast< value_left_t* >(left)));
+		}
+
+		static Node* node_of_right(base_t* right) noexcept
+		{
+			return static_cast< Node* >(static_cast< data_t* >(static_cast< value_right_t* >(right)));
+		}
+
+		static base_t* pair_of_left(base_t* left) noexcept { return as_right(node_of_left(left)); }
+
+		static base_t* pair_of_right(base_t* right) noexcept { return as_left(node_of_right(right)); }
+
+		static left_t& left_of(base_t* left) noexcept { return static_cast< value_left_t* >(left)->get(); }
+
+		static right_t& right_of(base_t* right) noexcept { return static_cast< value_right_t* >(right)->get(); }
+
+		bimap_base(CompareLeft compare_left, CompareRight compare_right) :
+			m_left_tree(std::move(compare_left)), m_right_tree(std::move(compare_right))
+		{
+			link_sentinels();
+		}
+
+		// Takes the comparators only, Derived copies the pairs.
+		bimap_base(const bimap_base& other) :
+			m_left_tree(other.m_left_tree.get_comparator()), m_right_tree(other.m_right_tree.get_comparator())
+		{
+			link_sentinels();
+		}
+
+		bimap_base(bimap_base&& other) noexcept :
+			m_count(other.m_count), m_pool(std::move(other.m_pool)), m_left_tree(std::move(other.m_left_tree)),
+			m_right_tree(std::move(other.m_right_tree))
+		{
+			other.m_count = 0;
+			link_sentinels();
+		}
+
+		bimap_base& operator=(const bimap_base&) = delete;
+
+		bimap_base& operator=(bimap_base&&) = delete;
+
+		~bimap_base() = default;
+
+		void link_sentinels() noexcept
+		{
+			m_left_tree.set_another_tree(m_right_tree.end());
+			m_right_tree.set_another_tree(m_left_tree.end());
+		}
+
+		void swap(bimap_base& other) noexcept
+		{
+			std::swap(m_count, other.m_count);
+			m_pool.swap(other.m_pool);
+			m_left_tree.swap(other.m_left_tree);
+			m_right_tree.swap(other.m_right_tree);
+		}
+
+		void clear() noexcept { erase_left(begin_left(), end_left()); }
+
+		// Links nodes created by the pool of this empty container, given in
+		// the order of each side, into perfectly balanced trees. Used by bulk
+		// builders and copies.
+		void link_sorted(const std::vector< Node* >& by_left, const std::vector< Node* >& by_right)
+		{
+			std::vector< base_t* > nodes(by_left.size());
+			for (std::size_t i = 0; i < by_left.size(); i++)
+			{
+				nodes[i] = as_left(by_left[i]);
+			}
+			m_left_tree.assign_sorted(nodes.data(), nodes.size());
+			for (std::size_t i = 0; i < by_right.size(); i++)
+			{
+				nodes[i] = as_right(by_right[i]);
+			}
+			m_right_tree.assign_sorted(nodes.data(), nodes.size());
+			m_count = by_left.size();
+		}
+
+		// Checks both trees, their sizes and that every pair is reachable
+		// from both sides. Equal neighbours are allowed unless unique.
+		bool check_links(bool unique) const noexcept
+		{
+			if (!m_left_tree.check_invariants(unique) || !m_right_tree.check_invariants(unique) ||
+				m_left_tree.size() != m_count || m_right_tree.size() != m_count)
+			{
+				return false;
+			}
+			for (base_t* left = m_left_tree.leftmost(); left != m_left_tree.end(); left = left->next(left))
+			{
+				if (!m_right_tree.holds(pair_of_left(left)))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+	  public:
+		// erase from range, removes [first, last), returns an iterator to the last
+		// element after the deleted sequence.
+		left_iterator erase_left(left_iterator first, left_iterator last) noexcept
+		{
+			for (left_iterator it(first); it != last; it = static_cast< Derived* >(this)->erase_left(it))
+			{
+			}
+			return last;
+		}
+
+		right_iterator erase_right(right_iterator first, right_iterator last) noexcept
+		{
+			for (right_iterator it(first); it != last; it = static_cast< Derived* >(this)->erase_right(it))
+			{
+			}
+			return last;
+		}
+
+		// Returns an iterator to the minimum order left.
+		left_iterator begin_left() const noexcept { return left_iterator(m_left_tree.begin()); }
+
+		left_iterator end_left() const noexcept { return left_iterator(m_left_tree.end()); }
+
+		// Returns an iterator to the minimum order of right.
+		right_iterator begin_right() const noexcept { return right_iterator(m_right_tree.begin()); }
+
+		right_iterator end_right() const noexcept { return right_iterator(m_right_tree.end()); }
+
+		// Check for emptiness.
+		bool empty() const noexcept { return !m_count; }
+
+		// Returns the size of the bimap (number of pairs).
+		std::size_t size() const noexcept { return m_count; }
+	};
+}	 // namespace bimap_details
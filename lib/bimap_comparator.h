@@ -7,12 +7,12 @@
 
 namespace bimap_details
 {
-	template< typename Key, bool Tree, typename Comparator >
+	template< typename Key, bool Tree, typename Comparator, typename Iteration = bimap_iteration::parent_walk >
 	struct comparator : Comparator
 	{
 		using key_t = Key;
 		using base_t = element_base;
-		using data_t = element_value< Tree, key_t >;
+		using data_t = element_value< Tree, key_t, Iteration >;
 
 		void swap(comparator& other) noexcept
 		{
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "bimap_iteration.h"
+
 #include <memory>
+#include <type_traits>
 #include <utility>
 
 namespace bimap_details
@@ -152,8 +155,110 @@ namespace bimap_details
 		}
 	};
 
-	template< bool Tree, typename Storage >
-	struct element_value : element_base
+	// A node of a tree with bimap_iteration::threaded.
+	struct threaded_element : element_base
+	{
+		// In-order neighbours within the tree, a circular list through the
+		// sentinel. An unlinked node is a list of its own.
+		threaded_element* pred = this;
+		threaded_element* succ = this;
+
+		// Puts the unlinked node between two neighbours.
+		void thread_between(threaded_element* before, threaded_element* after) noexcept
+		{
+			pred = before;
+			succ = after;
+			before->succ = this;
+			after->pred = this;
+		}
+
+		void unthread() noexcept
+		{
+			pred->succ = succ;
+			succ->pred = pred;
+			pred = this;
+			succ = this;
+		}
+
+		// Exchanges the places of two nodes in their lists, which may be the
+		// same list or where either node may be unlinked.
+		void rethread(threaded_element& other) noexcept
+		{
+			auto fix = [&](threaded_element*& link)
+			{
+				if (link == this)
+				{
+					link = &other;
+				}
+				else if (link == &other)
+				{
+					link = this;
+				}
+			};
+			std::swap(pred, other.pred);
+			std::swap(succ, other.succ);
+			fix(pred);
+			fix(succ);
+			fix(other.pred);
+			fix(other.succ);
+			pred->succ = this;
+			succ->pred = this;
+			other.pred->succ = &other;
+			other.succ->pred = &other;
+		}
+
+		// Exchanges the lists of two sentinels.
+		void exchange_threads(threaded_element& other) noexcept
+		{
+			std::swap(pred, other.pred);
+			std::swap(succ, other.succ);
+			adopt_thread(other);
+			other.adopt_thread(*this);
+		}
+
+		// Points the ends of a list taken from previous_owner back at this.
+		void adopt_thread(threaded_element& previous_owner) noexcept
+		{
+			if (succ == &previous_owner)
+			{
+				pred = this;
+				succ = this;
+			}
+			else
+			{
+				pred->succ = this;
+				succ->pred = this;
+			}
+		}
+
+		// Exchanges the places of two nodes in their trees and lists.
+		void swap(threaded_element& other) noexcept
+		{
+			element_base::swap(other);
+			rethread(other);
+		}
+
+		threaded_element() noexcept = default;
+
+		threaded_element(threaded_element&& other) noexcept { swap(other); }
+
+		threaded_element& operator=(threaded_element&& other) noexcept
+		{
+			if (this != std::addressof(other))
+			{
+				threaded_element(std::move(other)).swap(*this);
+			}
+			return *this;
+		}
+	};
+
+	// The base of the nodes of a tree iterated as Iteration says.
+	template< typename Iteration >
+	using node_base =
+		std::conditional_t< std::is_same_v< Iteration, bimap_iteration::threaded >, threaded_element, element_base >;
+
+	template< bool Tree, typename Storage, typename Iteration = bimap_iteration::parent_walk >
+	struct element_value : node_base< Iteration >
 	{
 		Storage storage;
 
@@ -164,12 +269,13 @@ namespace bimap_details
 		Storage& get() noexcept { return storage; }
 	};
 
-	template< typename Key, typename Value >
-	struct element_data : element_value< true, Key >, element_value< false, Value >
+	template< typename Key, typename Value, typename Iteration = bimap_iteration::parent_walk >
+	struct element_data : element_value< true, Key, Iteration >, element_value< false, Value, Iteration >
 	{
 		template< typename Key_f = Key, typename Value_f = Value >
 		element_data(Key_f&& key, Value_f&& value) :
-			element_value< true, Key >(std::forward< Key_f >(key)), element_value< false, Value >(std::forward< Value_f >(value))
+			element_value< true, Key, Iteration >(std::forward< Key_f >(key)),
+			element_value< false, Value, Iteration >(std::forward< Value_f >(value))
 		{
 		}
 	};
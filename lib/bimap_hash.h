@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+// Content fingerprints of bimap, passed as its template parameter after the
+// splaying strategy.
+namespace bimap_fingerprint
+{
+	// Nothing is kept, modifications do not hash, operator== compares pairs.
+	struct none
+	{
+	};
+
+	// A running sum of per-pair hashes is kept by every modification, which
+	// tells unequal maps apart in O(1) and gives content_hash(). Both sides
+	// must have std::hash and be compared by std::less.
+	struct hashed
+	{
+	};
+}	 // namespace bimap_fingerprint
+
+namespace bimap_details
+{
+	template< typename T, typename = void >
+	struct is_hashable : std::false_type
+	{
+	};
+
+	template< typename T >
+	struct is_hashable< T, std::void_t< decltype(std::hash< T >{}(std::declval< const T& >())) > > : std::true_type
+	{
+	};
+
+	template< typename T, typename Comparator >
+	constexpr bool is_hash_consistent =
+		is_hashable< T >::value && (std::is_same_v< Comparator, std::less< T > > || std::is_same_v< Comparator, std::less<> >);
+
+	// A content fingerprint is only meaningful when equivalence under both
+	// comparators implies equal std::hash values, that is for std::less.
+	template< typename Left, typename Right, typename CompareLeft, typename CompareRight >
+	constexpr bool has_fingerprint = is_hash_consistent< Left, CompareLeft > && is_hash_consistent< Right, CompareRight >;
+
+	// Storage of the fingerprint, a base so that it takes no room when it
+	// is not kept.
+	template< bool Kept >
+	struct fingerprint_holder
+	{
+	  protected:
+		std::uint64_t m_fingerprint = 0;
+
+		std::uint64_t fingerprint() const noexcept { return m_fingerprint; }
+
+		void add_to_fingerprint(std::uint64_t hash) noexcept { m_fingerprint += hash; }
+
+		void swap_fingerprint(fingerprint_holder& other) noexcept { std::swap(m_fingerprint, other.m_fingerprint); }
+	};
+
+	template<>
+	struct fingerprint_holder< false >
+	{
+	  protected:
+		std::uint64_t fingerprint() const noexcept { return 0; }
+
+		void add_to_fingerprint(std::uint64_t) noexcept {}
+
+		void swap_fingerprint(fingerprint_holder&) noexcept {}
+	};
+
+	// splitmix64 finalizer.
+	inline std::uint64_t mix(std::uint64_t x) noexcept
+	{
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ULL;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebULL;
+		x ^= x >> 31;
+		return x;
+	}
+
+	// Hash of a single pair. Fingerprints are sums of these, so they do not
+	// depend on the order of insertions and can be updated on erase.
+	template< typename Left, typename Right >
+	std::uint64_t pair_hash(const Left& left, const Right& right) noexcept
+	{
+		return mix(mix(std::hash< Left >{}(left)) + std::hash< Right >{}(right));
+	}
+}	 // namespace bimap_details
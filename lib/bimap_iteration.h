@@ -0,0 +1,18 @@
+#pragma once
+
+// Iteration strategies of bimap, passed as its last template parameter.
+namespace bimap_iteration
+{
+	// Iterators climb and descend parent links, amortized constant time per
+	// step.
+	struct parent_walk
+	{
+	};
+
+	// Nodes also keep their in-order neighbours within each tree, so a step
+	// is a single load. Costs two more pointers per node and side, kept up
+	// to date by every modification.
+	struct threaded
+	{
+	};
+}	 // namespace bimap_iteration
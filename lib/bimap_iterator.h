@@ -5,10 +5,15 @@
 
 #include <cstddef>
 #include <iterator>
+#include <utility>
+
+#if __cplusplus >= 202002L
+#include <ranges>
+#endif
 
 namespace bimap_details
 {
-	template< typename Key, typename Value, bool Tree >
+	template< typename Key, typename Value, bool Tree, typename Iteration = bimap_iteration::parent_walk >
 	struct base_iterator
 	{
 	  public:
@@ -21,20 +26,35 @@ namespace bimap_details
 	  private:
 		using value_type_another = std::conditional_t< Tree, Value, Key >;
 		using base_t = element_base;
-		using elem_t = element_value< Tree, value_type >;
-		using elem_another_t = element_value< !Tree, value_type_another >;
-		using doub_t = element_data< Key, Value >;
+		using node_t = node_base< Iteration >;
+		using elem_t = element_value< Tree, value_type, Iteration >;
+		using elem_another_t = element_value< !Tree, value_type_another, Iteration >;
+		using doub_t = element_data< Key, Value, Iteration >;
+
+		static constexpr bool threaded = std::is_same_v< Iteration, bimap_iteration::threaded >;
 
 		base_t* value = nullptr;
 
-		template< typename FLt, typename FRt, typename FCLt, typename FCRt >
+		template< typename FLt, typename FRt, typename FCLt, typename FCRt, typename FSp, typename FFp, typename FIt >
 		friend struct ::bimap;
 
-		friend struct base_iterator< Key, Value, !Tree >;
+		template< typename FLt, typename FRt, typename FCLt, typename FCRt, typename FSp, typename FIt >
+		friend struct ::multi_bimap;
+
+		template< typename FLt, typename FRt, typename FCLt, typename FCRt, typename FEv, typename FSp, typename FIt >
+		friend struct ::bounded_bimap;
+
+		template< typename FD, typename FLt, typename FRt, typename FCLt, typename FCRt, typename FSp, typename FIt, typename FN >
+		friend struct bimap_base;
+
+		friend struct base_iterator< Key, Value, !Tree, Iteration >;
 
 		base_iterator(base_t* value) noexcept : value(value) {}
 
 	  public:
+		// A singular iterator, it may only be assigned to.
+		base_iterator() noexcept = default;
+
 		// The element that the iterator currently refers to.
 		// Dereferencing the iterator end_left() is undefined.
 		// Dereferencing an invalid iterator is undefined.
@@ -48,9 +68,17 @@ namespace bimap_details
 		// Move to the next largest left.
 		// The increment of the end_left() iterator is undefined.
 		// The increment of an invalid iterator is undefined.
+		// With bimap_iteration::threaded this is a single load.
 		base_iterator& operator++() noexcept
 		{
-			value = value->next(value);
+			if constexpr (threaded)
+			{
+				value = static_cast< node_t* >(value)->succ;
+			}
+			else
+			{
+				value = value->next(value);
+			}
 			return *this;
 		}
 
@@ -66,7 +94,14 @@ namespace bimap_details
 		// Decrement of an invalid iterator is undefined.
 		base_iterator& operator--() noexcept
 		{
-			value = value->prev(value);
+			if constexpr (threaded)
+			{
+				value = static_cast< node_t* >(value)->pred;
+			}
+			else
+			{
+				value = value->prev(value);
+			}
 			return *this;
 		}
 
@@ -82,16 +117,16 @@ namespace bimap_details
 		// end_left().flip() returns end_right().
 		// end_right().flip() returns end_left().
 		// flip() of an invalid iterator is undefined.
-		base_iterator< Key, Value, !Tree > flip() const noexcept
+		base_iterator< Key, Value, !Tree, Iteration > flip() const noexcept
 		{
 			if (value->parent)
 			{
-				return base_iterator< Key, Value, !Tree >(static_cast< base_t* >(
+				return base_iterator< Key, Value, !Tree, Iteration >(static_cast< base_t* >(
 					static_cast< elem_another_t* >(static_cast< doub_t* >(static_cast< elem_t* >(value)))));
 			}
 			else
 			{
-				return base_iterator< Key, Value, !Tree >(value->right);
+				return base_iterator< Key, Value, !Tree, Iteration >(value->right);
 			}
 		}
 
@@ -99,4 +134,60 @@ namespace bimap_details
 
 		bool operator!=(const base_iterator& other) const noexcept { return value != other.value; }
 	};
+
+	// A half-open range of iterators, the same type in every language
+	// mode. It can be iterated, unpacked with structured bindings or read
+	// through first and second. Since C++20 it is a borrowed view.
+	template< typename Iterator >
+	struct iterator_range
+#if __cplusplus >= 202002L
+		: std::ranges::view_base
+#endif
+	{
+		Iterator first;
+		Iterator second;
+
+		iterator_range() noexcept = default;
+
+		iterator_range(Iterator first, Iterator second) noexcept : first(first), second(second) {}
+
+		Iterator begin() const noexcept { return first; }
+
+		Iterator end() const noexcept { return second; }
+
+		bool empty() const noexcept { return first == second; }
+
+		template< std::size_t I >
+		Iterator get() const noexcept
+		{
+			static_assert(I < 2, "An iterator range has two iterators");
+			if constexpr (I == 0)
+			{
+				return first;
+			}
+			else
+			{
+				return second;
+			}
+		}
+	};
 }	 // namespace bimap_details
+
+namespace std
+{
+	template< typename Iterator >
+	struct tuple_size< bimap_details::iterator_range< Iterator > > : integral_constant< size_t, 2 >
+	{
+	};
+
+	template< size_t I, typename Iterator >
+	struct tuple_element< I, bimap_details::iterator_range< Iterator > >
+	{
+		using type = Iterator;
+	};
+
+#if __cplusplus >= 202002L
+	template< typename Iterator >
+	inline constexpr bool ranges::enable_borrowed_range< bimap_details::iterator_range< Iterator > > = true;
+#endif
+}	 // namespace std
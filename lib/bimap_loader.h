@@ -0,0 +1,400 @@
+#pragma once
+
+#include "bimap.h"
+#include "bimap_parallel.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+// Builds a bimap from a stream of pairs produced by other threads.
+//
+// Producers push pairs into a bounded queue, with push() blocking while
+// the queue is full, or, since C++20, with co_await async_push() which
+// suspends instead and is resumed through an executor. A builder thread
+// drains the queue in batches and sorts every batch by left while the
+// producers go on. finish() merges the batches, drops pairs exactly like
+// consecutive bimap::insert calls in arrival order would, and links both
+// trees in bulk.
+template< typename Left,
+		  typename Right,
+		  typename CompareLeft = std::less< Left >,
+		  typename CompareRight = std::less< Right >,
+		  typename Splay = bimap_splay::bottom_up,
+		  typename Fingerprint = bimap_fingerprint::none,
+		  typename Iteration = bimap_iteration::parent_walk >
+struct bimap_loader
+{
+  public:
+	using bimap_t = bimap< Left, Right, CompareLeft, CompareRight, Splay, Fingerprint, Iteration >;
+	using value_type = std::pair< Left, Right >;
+
+#if defined(__cpp_impl_coroutine)
+	// Called with a suspended producer once its pair is queued. It runs on
+	// the builder thread, so it must only schedule the handle, e.g. post it
+	// to the producer's event loop or a thread pool, and not throw.
+	using executor = std::function< void(std::coroutine_handle<>) >;
+
+	struct push_awaiter;
+#endif
+
+  private:
+	using data_t = typename bimap_t::data_t;
+
+	struct entry
+	{
+		value_type pair;
+		std::size_t arrival;
+	};
+
+	std::mutex m_mutex;
+	std::condition_variable m_not_full;
+	std::condition_variable m_not_empty;
+	std::deque< value_type > m_queue;
+	bool m_closed = false;
+#if defined(__cpp_impl_coroutine)
+	std::deque< push_awaiter* > m_waiting;
+#endif
+
+	const std::size_t m_capacity;
+	const std::size_t m_batch;
+	const std::size_t m_threads;
+	CompareLeft m_compare_left;
+	CompareRight m_compare_right;
+
+	// Owned by the builder thread until it is joined.
+	std::vector< entry > m_entries;
+	std::vector< std::size_t > m_runs;
+	std::exception_ptr m_error;
+
+	std::thread m_builder;
+
+	bool left_less(const entry& a, const entry& b) const { return m_compare_left(a.pair.first, b.pair.first); }
+
+	// Queues the pair if there is room. Must be called under the lock.
+	bool enqueue(value_type& pair)
+	{
+		if (m_queue.size() >= m_capacity)
+		{
+			return false;
+		}
+		m_queue.push_back(std::move(pair));
+		m_not_empty.notify_one();
+		return true;
+	}
+
+#if defined(__cpp_impl_coroutine)
+	// Producers whose pairs are queued. The awaiter may be gone as soon as
+	// its producer is resumed, so the executor is moved out first.
+	using ready_t = std::vector< std::pair< std::coroutine_handle<>, executor > >;
+
+	static void hand_over(push_awaiter* waiting, ready_t& ready)
+	{
+		ready.emplace_back(waiting->m_handle, std::move(waiting->m_resume));
+	}
+
+	static void resume_all(ready_t& ready)
+	{
+		for (auto& [handle, resume] : ready)
+		{
+			resume(handle);
+		}
+	}
+#endif
+
+	void build_runs()
+	{
+		std::vector< value_type > batch;
+		try
+		{
+			while (true)
+			{
+#if defined(__cpp_impl_coroutine)
+				ready_t ready;
+#endif
+				{
+					std::unique_lock< std::mutex > lock(m_mutex);
+					m_not_empty.wait(lock, [this] { return !m_queue.empty() || m_closed; });
+					while (!m_queue.empty() && batch.size() < m_batch)
+					{
+						batch.push_back(std::move(m_queue.front()));
+						m_queue.pop_front();
+					}
+#if defined(__cpp_impl_coroutine)
+					while (!m_waiting.empty() && m_queue.size() < m_capacity)
+					{
+						push_awaiter* waiting = m_waiting.front();
+						m_waiting.pop_front();
+						m_queue.push_back(std::move(waiting->m_pair));
+						waiting->m_result = true;
+						hand_over(waiting, ready);
+					}
+#endif
+					if (batch.empty() && m_queue.empty())
+					{
+						return;
+					}
+				}
+				m_not_full.notify_all();
+#if defined(__cpp_impl_coroutine)
+				resume_all(ready);
+#endif
+				for (value_type& pair : batch)
+				{
+					m_entries.push_back({ std::move(pair), m_entries.size() });
+				}
+				batch.clear();
+				std::stable_sort(m_entries.begin() + m_runs.back(),
+								 m_entries.end(),
+								 [this](const entry& a, const entry& b) { return left_less(a, b); });
+				m_runs.push_back(m_entries.size());
+			}
+		} catch (...)
+		{
+#if defined(__cpp_impl_coroutine)
+			ready_t ready;
+#endif
+			{
+				std::lock_guard< std::mutex > lock(m_mutex);
+				m_error = std::current_exception();
+				m_closed = true;
+				m_queue.clear();
+#if defined(__cpp_impl_coroutine)
+				for (push_awaiter* waiting : m_waiting)
+				{
+					hand_over(waiting, ready);
+				}
+				m_waiting.clear();
+#endif
+			}
+			m_not_full.notify_all();
+#if defined(__cpp_impl_coroutine)
+			resume_all(ready);
+#endif
+		}
+	}
+
+	// Ids of the groups of equivalent keys of one side, by arrival.
+	template< typename Key, typename Compare >
+	static std::vector< std::size_t >
+		group(const std::vector< entry >& entries, const std::vector< std::size_t >& order, Key key, const Compare& compare)
+	{
+		std::vector< std::size_t > res(entries.size());
+		std::size_t id = 0;
+		for (std::size_t i = 0; i < order.size(); i++)
+		{
+			if (i && compare(key(entries[order[i - 1]]), key(entries[order[i]])))
+			{
+				id++;
+			}
+			res[entries[order[i]].arrival] = id;
+		}
+		return res;
+	}
+
+  public:
+	// capacity bounds the queue, batch bounds the number of pairs the
+	// builder takes at once, threads is used by finish().
+	explicit bimap_loader(std::size_t capacity = 1 << 16,
+						  std::size_t batch = 1 << 12,
+						  std::size_t threads = std::max(1u, std::thread::hardware_concurrency()),
+						  CompareLeft compare_left = CompareLeft(),
+						  CompareRight compare_right = CompareRight()) :
+		m_capacity(std::max< std::size_t >(1, capacity)), m_batch(std::max< std::size_t >(1, batch)),
+		m_threads(std::max< std::size_t >(1, threads)), m_compare_left(std::move(compare_left)),
+		m_compare_right(std::move(compare_right)), m_runs(1, 0), m_builder([this] { build_runs(); })
+	{
+	}
+
+	bimap_loader(const bimap_loader&) = delete;
+
+	bimap_loader& operator=(const bimap_loader&) = delete;
+
+	// Pairs that are still queued are dropped if finish() was not called.
+	~bimap_loader()
+	{
+		close();
+		if (m_builder.joinable())
+		{
+			m_builder.join();
+		}
+	}
+
+	// Queues a pair, waiting while the queue is full. Returns false if the
+	// loader is closed, in which case the pair is dropped.
+	bool push(value_type pair)
+	{
+		std::unique_lock< std::mutex > lock(m_mutex);
+		m_not_full.wait(lock, [this] { return m_closed || m_queue.size() < m_capacity; });
+		return !m_closed && enqueue(pair);
+	}
+
+	bool push(Left left, Right right) { return push(value_type(std::move(left), std::move(right))); }
+
+#if defined(__cpp_impl_coroutine)
+	// co_await async_push(pair, resume) queues a pair, suspending the
+	// coroutine while the queue is full. Once the builder queued the pair it
+	// passes the coroutine to resume, and the coroutine continues wherever
+	// that runs it. Without suspending it continues on the calling thread.
+	// Yields false if the loader is closed.
+	struct push_awaiter
+	{
+	  private:
+		bimap_loader& m_loader;
+		value_type m_pair;
+		executor m_resume;
+		std::coroutine_handle<> m_handle;
+		bool m_result = false;
+
+		friend struct bimap_loader;
+
+	  public:
+		push_awaiter(bimap_loader& loader, value_type pair, executor resume) :
+			m_loader(loader), m_pair(std::move(pair)), m_resume(std::move(resume))
+		{
+		}
+
+		bool await_ready() { return false; }
+
+		bool await_suspend(std::coroutine_handle<> handle)
+		{
+			std::lock_guard< std::mutex > lock(m_loader.m_mutex);
+			if (m_loader.m_closed || m_loader.enqueue(m_pair))
+			{
+				m_result = !m_loader.m_closed;
+				return false;
+			}
+			m_handle = handle;
+			m_loader.m_waiting.push_back(this);
+			return true;
+		}
+
+		bool await_resume() const noexcept { return m_result; }
+	};
+
+	push_awaiter async_push(value_type pair, executor resume)
+	{
+		return push_awaiter(*this, std::move(pair), std::move(resume));
+	}
+#endif
+
+	// No more pairs will be pushed, further pushes return false.
+	void close()
+	{
+		std::lock_guard< std::mutex > lock(m_mutex);
+		m_closed = true;
+		m_not_empty.notify_all();
+		m_not_full.notify_all();
+	}
+
+	// Closes the loader, waits for the builder and returns the bimap of
+	// the pushed pairs. Must be called after all pushes returned, and not
+	// from a coroutine resumed by an executor on the builder thread. Later
+	// calls return an empty bimap, also after a throw.
+	bimap_t finish()
+	{
+		close();
+		if (m_builder.joinable())
+		{
+			m_builder.join();
+		}
+		try
+		{
+			if (m_error)
+			{
+				std::rethrow_exception(std::exchange(m_error, nullptr));
+			}
+			return build();
+		} catch (...)
+		{
+			m_entries.clear();
+			m_runs.assign(1, 0);
+			throw;
+		}
+	}
+
+  private:
+	// Merges the runs into the result, once the builder is joined. Pairs
+	// may be moved out of m_entries before a throw.
+	bimap_t build()
+	{
+		bimap_details::merge_runs(
+			m_entries, m_runs, [this](const entry& a, const entry& b) { return left_less(a, b); }, m_threads);
+		std::size_t count = m_entries.size();
+
+		std::vector< std::size_t > by_left(count);
+		std::iota(by_left.begin(), by_left.end(), 0);
+		std::vector< std::size_t > by_right(by_left);
+		bimap_details::parallel_sort(
+			by_right,
+			[this](std::size_t a, std::size_t b) { return m_compare_right(m_entries[a].pair.second, m_entries[b].pair.second); },
+			m_threads);
+
+		std::vector< std::size_t > left_group =
+			group(m_entries, by_left, [](const entry& e) -> const Left& { return e.pair.first; }, m_compare_left);
+		std::vector< std::size_t > right_group =
+			group(m_entries, by_right, [](const entry& e) -> const Right& { return e.pair.second; }, m_compare_right);
+
+		// A pair is kept if no earlier kept pair has its left or its right.
+		std::vector< char > accepted(count), left_used(count), right_used(count);
+		std::size_t accepted_count = 0;
+		for (std::size_t arrival = 0; arrival < count; arrival++)
+		{
+			if (!left_used[left_group[arrival]] && !right_used[right_group[arrival]])
+			{
+				accepted[arrival] = left_used[left_group[arrival]] = right_used[right_group[arrival]] = 1;
+				accepted_count++;
+			}
+		}
+
+		bimap_t res(m_compare_left, m_compare_right);
+		std::vector< data_t* > node_of(count, nullptr);
+		std::vector< data_t* > nodes_by_left;
+		std::vector< data_t* > nodes_by_right;
+		try
+		{
+			nodes_by_left.reserve(accepted_count);
+			nodes_by_right.reserve(accepted_count);
+			res.m_pool.reserve(accepted_count);
+			for (entry& e : m_entries)
+			{
+				if (accepted[e.arrival])
+				{
+					node_of[e.arrival] = res.m_pool.create(std::move(e.pair.first), std::move(e.pair.second));
+					nodes_by_left.push_back(node_of[e.arrival]);
+				}
+			}
+			for (std::size_t position : by_right)
+			{
+				if (accepted[m_entries[position].arrival])
+				{
+					nodes_by_right.push_back(node_of[m_entries[position].arrival]);
+				}
+			}
+			res.link_sorted(nodes_by_left, nodes_by_right);
+		} catch (...)
+		{
+			for (data_t* node : nodes_by_left)
+			{
+				res.m_pool.destroy(node);
+			}
+			throw;
+		}
+
+		m_entries.clear();
+		m_runs.assign(1, 0);
+		return res;
+	}
+};
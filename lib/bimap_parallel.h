@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bimap_details
+{
+	// Runs task(i) for every i in [0, count) on up to threads threads, the
+	// calling one included. The first exception thrown by a task is rethrown.
+	template< typename Task >
+	void run_parallel(std::size_t count, std::size_t threads, Task task)
+	{
+		std::atomic< std::size_t > next(0);
+		std::exception_ptr error;
+		std::mutex error_mutex;
+		auto work = [&]
+		{
+			for (std::size_t i; (i = next++) < count;)
+			{
+				try
+				{
+					task(i);
+				} catch (...)
+				{
+					std::lock_guard< std::mutex > lock(error_mutex);
+					if (!error)
+					{
+						error = std::current_exception();
+					}
+				}
+			}
+		};
+
+		std::vector< std::thread > workers;
+		try
+		{
+			for (std::size_t i = 1; i < std::min(threads, count); i++)
+			{
+				workers.emplace_back(work);
+			}
+		} catch (...)
+		{
+			for (std::thread& worker : workers)
+			{
+				worker.join();
+			}
+			throw;
+		}
+		work();
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+
+	// Stable merge of the consecutive sorted runs [bounds[i], bounds[i + 1])
+	// of v, merging pairs of neighbouring runs in parallel on each level.
+	template< typename T, typename Less >
+	void merge_runs(std::vector< T >& v, std::vector< std::size_t > bounds, Less less, std::size_t threads)
+	{
+		while (bounds.size() > 2)
+		{
+			run_parallel((bounds.size() - 1) / 2,
+						 threads,
+						 [&](std::size_t i)
+						 {
+							 std::inplace_merge(v.begin() + bounds[2 * i],
+												v.begin() + bounds[2 * i + 1],
+												v.begin() + bounds[2 * i + 2],
+												less);
+						 });
+			std::vector< std::size_t > merged;
+			for (std::size_t i = 0; i < bounds.size(); i += 2)
+			{
+				merged.push_back(bounds[i]);
+			}
+			if (merged.back() != bounds.back())
+			{
+				merged.push_back(bounds.back());
+			}
+			bounds.swap(merged);
+		}
+	}
+
+	// Stable sort of chunks in parallel, followed by merge_runs.
+	template< typename T, typename Less >
+	void parallel_sort(std::vector< T >& v, Less less, std::size_t threads)
+	{
+		std::size_t chunks = std::max< std::size_t >(1, std::min(threads, v.size() / 4096));
+		std::vector< std::size_t > bounds(chunks + 1);
+		for (std::size_t i = 0; i <= chunks; i++)
+		{
+			bounds[i] = v.size() * i / chunks;
+		}
+		run_parallel(chunks,
+					 threads,
+					 [&](std::size_t i) { std::stable_sort(v.begin() + bounds[i], v.begin() + bounds[i + 1], less); });
+		merge_runs(v, std::move(bounds), less, threads);
+	}
+}	 // namespace bimap_details
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace bimap_details
+{
+	// Storage for the nodes of a single container.
+	// The first nodes are allocated one by one, so a small map costs no more
+	// than with plain new. Past that, nodes are carved out of contiguous
+	// chunks of growing size, each with its own intrusive free list, so there
+	// is no per-node allocator header and neighbouring pairs tend to share
+	// cache lines. A chunk whose nodes are all destroyed is given back, except
+	// for one kept to absorb erase and insert cycles.
+	template< typename Node >
+	struct node_pool
+	{
+	  private:
+		union slot
+		{
+			slot* next;
+			alignas(Node) unsigned char storage[sizeof(Node)];
+		};
+
+		// Nodes allocated one by one before chunks are used.
+		static constexpr std::size_t separate_nodes = 32;
+		static constexpr std::size_t min_chunk = separate_nodes;
+		static constexpr std::size_t max_chunk = std::max< std::size_t >(min_chunk, (64 << 10) / sizeof(slot));
+
+		struct chunk
+		{
+			std::unique_ptr< slot[] > slots;
+			std::size_t size;
+			std::size_t live = 0;
+			slot* free = nullptr;
+			slot* next;
+			// Neighbours in the list of chunks with room.
+			chunk* prev_with_room = nullptr;
+			chunk* next_with_room = nullptr;
+
+			explicit chunk(std::size_t size) : slots(new slot[size]), size(size), next(slots.get()) {}
+
+			bool contains(const slot* s) const noexcept
+			{
+				return !std::less< const slot* >()(s, slots.get()) && std::less< const slot* >()(s, slots.get() + size);
+			}
+
+			bool full() const noexcept { return !free && next == slots.get() + size; }
+		};
+
+		// Only allocated once the first chunk is needed.
+		struct state
+		{
+			// Ordered by address, for deallocate to find the owner of a node.
+			std::vector< std::unique_ptr< chunk > > chunks;
+			chunk* with_room = nullptr;
+			chunk* last_used = nullptr;
+			chunk* spare = nullptr;
+			std::size_t capacity = 0;
+			std::size_t room = 0;
+		};
+
+		std::unique_ptr< state > m_state;
+		std::size_t m_live = 0;
+
+		void link_with_room(chunk* c) noexcept
+		{
+			c->prev_with_room = nullptr;
+			c->next_with_room = m_state->with_room;
+			if (m_state->with_room)
+			{
+				m_state->with_room->prev_with_room = c;
+			}
+			m_state->with_room = c;
+		}
+
+		void unlink_with_room(chunk* c) noexcept
+		{
+			(c->prev_with_room ? c->prev_with_room->next_with_room : m_state->with_room) = c->next_with_room;
+			if (c->next_with_room)
+			{
+				c->next_with_room->prev_with_room = c->prev_with_room;
+			}
+			c->prev_with_room = nullptr;
+			c->next_with_room = nullptr;
+		}
+
+		typename std::vector< std::unique_ptr< chunk > >::iterator position_of(const slot* s) const noexcept
+		{
+			return std::upper_bound(m_state->chunks.begin(),
+									m_state->chunks.end(),
+									s,
+									[](const slot* key, const std::unique_ptr< chunk >& c)
+									{ return std::less< const slot* >()(key, c->slots.get()); });
+		}
+
+		// Returns the chunk holding s, or nullptr if s was allocated alone.
+		chunk* owner_of(const slot* s) const noexcept
+		{
+			if (!m_state)
+			{
+				return nullptr;
+			}
+			if (m_state->last_used && m_state->last_used->contains(s))
+			{
+				return m_state->last_used;
+			}
+			auto it = position_of(s);
+			if (it == m_state->chunks.begin() || !(*std::prev(it))->contains(s))
+			{
+				return nullptr;
+			}
+			return m_state->last_used = std::prev(it)->get();
+		}
+
+		// Adds a chunk with room for count nodes, which is used first.
+		void grow(std::size_t count)
+		{
+			if (!m_state)
+			{
+				m_state = std::make_unique< state >();
+			}
+			m_state->chunks.reserve(m_state->chunks.size() + 1);
+			auto added = std::make_unique< chunk >(count);
+			chunk* c = added.get();
+			m_state->chunks.insert(position_of(c->slots.get()), std::move(added));
+			m_state->capacity += count;
+			m_state->room += count;
+			link_with_room(c);
+		}
+
+		void release(chunk* c) noexcept
+		{
+			unlink_with_room(c);
+			m_state->capacity -= c->size;
+			m_state->room -= c->size;
+			if (m_state->last_used == c)
+			{
+				m_state->last_used = nullptr;
+			}
+			m_state->chunks.erase(std::prev(position_of(c->slots.get())));
+		}
+
+		slot* allocate()
+		{
+			chunk* c = (m_state ? m_state->with_room : nullptr);
+			if (!c)
+			{
+				if (m_live < separate_nodes)
+				{
+					slot* res = new slot;
+					m_live++;
+					return res;
+				}
+				grow(std::min(std::max(m_state ? m_state->capacity : std::size_t(0), min_chunk), max_chunk));
+				c = m_state->with_room;
+			}
+			slot* res;
+			if (c->free)
+			{
+				res = c->free;
+				c->free = res->next;
+			}
+			else
+			{
+				res = c->next++;
+			}
+			if (c->full())
+			{
+				unlink_with_room(c);
+			}
+			if (m_state->spare == c)
+			{
+				m_state->spare = nullptr;
+			}
+			c->live++;
+			m_state->room--;
+			m_live++;
+			return res;
+		}
+
+		void deallocate(slot* s) noexcept
+		{
+			m_live--;
+			chunk* c = owner_of(s);
+			if (!c)
+			{
+				delete s;
+				return;
+			}
+			if (c->full())
+			{
+				link_with_room(c);
+			}
+			s->next = c->free;
+			c->free = s;
+			c->live--;
+			m_state->room++;
+			if (!c->live)
+			{
+				// Fresh again, so that it is filled in address order.
+				c->free = nullptr;
+				c->next = c->slots.get();
+				if (!m_state->spare)
+				{
+					m_state->spare = c;
+				}
+				else
+				{
+					release(c);
+				}
+			}
+		}
+
+	  public:
+		node_pool() noexcept = default;
+
+		node_pool(const node_pool&) = delete;
+
+		node_pool(node_pool&& other) noexcept { swap(other); }
+
+		node_pool& operator=(const node_pool&) = delete;
+
+		node_pool& operator=(node_pool&& other) noexcept
+		{
+			if (this != std::addressof(other))
+			{
+				node_pool(std::move(other)).swap(*this);
+			}
+			return *this;
+		}
+
+		// All nodes must have been destroyed before the pool goes away.
+		~node_pool() = default;
+
+		void swap(node_pool& other) noexcept
+		{
+			m_state.swap(other.m_state);
+			std::swap(m_live, other.m_live);
+		}
+
+		// Makes sure the next count nodes are created without allocating.
+		// If there was no room left, they are placed contiguously.
+		void reserve(std::size_t count)
+		{
+			std::size_t room = (m_state ? m_state->room : 0);
+			if (room < count)
+			{
+				grow(count - room);
+			}
+		}
+
+		template< typename... Args >
+		Node* create(Args&&... args)
+		{
+			slot* s = allocate();
+			try
+			{
+				return ::new (static_cast< void* >(s->storage)) Node(std::forward< Args >(args)...);
+			} catch (...)
+			{
+				deallocate(s);
+				throw;
+			}
+		}
+
+		void destroy(Node* node) noexcept
+		{
+			node->~Node();
+			deallocate(reinterpret_cast< slot* >(node));
+		}
+	};
+}	 // namespace bimap_details
@@ -0,0 +1,524 @@
+#pragma once
+
+#include "bimap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace bimap_details
+{
+	// An immutable bimap in two flat arrays: pairs ordered by left, and
+	// positions of pairs ordered by right. Lookups are binary searches that
+	// never write, so any number of threads may share one.
+	template< typename Left, typename Right, typename CompareLeft, typename CompareRight >
+	struct flat_bimap
+	{
+		using value_type = std::pair< Left, Right >;
+
+		std::vector< value_type > pairs;
+		std::vector< std::size_t > by_right;
+		CompareLeft compare_left;
+		CompareRight compare_right;
+
+		flat_bimap(std::vector< value_type > sorted_by_left, CompareLeft compare_left, CompareRight compare_right) :
+			pairs(std::move(sorted_by_left)), by_right(pairs.size()), compare_left(std::move(compare_left)),
+			compare_right(std::move(compare_right))
+		{
+			for (std::size_t i = 0; i < by_right.size(); i++)
+			{
+				by_right[i] = i;
+			}
+			std::sort(by_right.begin(),
+					  by_right.end(),
+					  [this](std::size_t a, std::size_t b) { return this->compare_right(pairs[a].second, pairs[b].second); });
+		}
+
+		const value_type* find_left(const Left& left) const noexcept
+		{
+			auto it = std::lower_bound(pairs.begin(),
+									   pairs.end(),
+									   left,
+									   [this](const value_type& pair, const Left& key) { return compare_left(pair.first, key); });
+			return (it != pairs.end() && !compare_left(left, it->first) ? &*it : nullptr);
+		}
+
+		const value_type* find_right(const Right& right) const noexcept
+		{
+			auto it = std::lower_bound(by_right.begin(),
+									   by_right.end(),
+									   right,
+									   [this](std::size_t pos, const Right& key) { return compare_right(pairs[pos].second, key); });
+			return (it != by_right.end() && !compare_right(right, pairs[*it].second) ? &pairs[*it] : nullptr);
+		}
+	};
+}	 // namespace bimap_details
+
+// A bimap written through a primary and read through per-group replicas.
+// Writes lock the primary. A publisher thread turns the primary into an
+// immutable flat copy after batch writes, or after interval if fewer writes
+// are pending. Each group, e.g. the threads of one NUMA node, owns a thread
+// that copies every publication once, so that with first-touch page
+// placement and the thread pinned to the node the replica lives in local
+// memory. The readers of the group share that replica without locking and
+// notice a new one by one load of the group's counter.
+//
+// Readers see writes with a delay of up to interval plus the copy, and
+// never a partial batch. Publishing copies the primary under its lock in
+// linear time, and each group copies it once more on its own thread.
+template< typename Left,
+		  typename Right,
+		  typename CompareLeft = std::less< Left >,
+		  typename CompareRight = std::less< Right >,
+		  typename Splay = bimap_splay::bottom_up >
+struct replicated_bimap
+{
+  public:
+	using left_t = Left;
+	using right_t = Right;
+
+  private:
+	using flat_t = bimap_details::flat_bimap< left_t, right_t, CompareLeft, CompareRight >;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bimap< left_t, right_t, CompareLeft, CompareRight, Splay > m_primary;
+	// Writes so far, and how many of them the latest publication holds.
+	std::uint64_t m_written = 0;
+	std::uint64_t m_covered = 0;
+	std::uint64_t m_copies = 0;
+	bool m_stopped = false;
+
+	const std::size_t m_batch;
+	const std::chrono::milliseconds m_interval;
+
+	// The latest publication, guarded by its own lock so that readers do
+	// not wait for writers.
+	mutable std::mutex m_published_mutex;
+	std::shared_ptr< const flat_t > m_published;
+	std::uint64_t m_published_copy = 0;
+	std::atomic< std::uint64_t > m_version;
+
+  public:
+	struct group;
+
+  private:
+	// Groups to wake on a publication, guarded by the publication lock.
+	mutable std::vector< group* > m_groups;
+
+	std::thread m_publisher;
+
+	// Must be called under the primary lock, which it releases while the
+	// copy is sorted by right.
+	void publish_locked(std::unique_lock< std::mutex >& lock)
+	{
+		std::vector< std::pair< left_t, right_t > > pairs;
+		pairs.reserve(m_primary.size());
+		for (auto it = m_primary.begin_left(); it != m_primary.end_left(); ++it)
+		{
+			pairs.emplace_back(*it, *it.flip());
+		}
+		CompareLeft compare_left = m_primary.key_comp_left();
+		CompareRight compare_right = m_primary.key_comp_right();
+		std::uint64_t copy = ++m_copies;
+		std::uint64_t written = m_written;
+		lock.unlock();
+		auto published = std::make_shared< const flat_t >(std::move(pairs), std::move(compare_left), std::move(compare_right));
+		{
+			// A concurrent publish() may have finished a later copy first.
+			std::lock_guard< std::mutex > published_lock(m_published_mutex);
+			if (copy > m_published_copy)
+			{
+				m_published = std::move(published);
+				m_published_copy = copy;
+				m_version.fetch_add(1, std::memory_order_release);
+				for (group* g : m_groups)
+				{
+					g->wake();
+				}
+			}
+		}
+		lock.lock();
+		// Only now are the copied writes no longer pending, so a throw above
+		// leaves them for the next publication.
+		m_covered = std::max(m_covered, written);
+	}
+
+	std::uint64_t pending() const noexcept { return m_written - m_covered; }
+
+	void run_publisher()
+	{
+		std::unique_lock< std::mutex > lock(m_mutex);
+		while (!m_stopped)
+		{
+			m_wake.wait_for(lock, m_interval, [this] { return m_stopped || pending() >= m_batch; });
+			if (pending())
+			{
+				try
+				{
+					publish_locked(lock);
+				} catch (...)
+				{
+					// The previous version stays published and the writes stay
+					// pending. Waits a full interval before trying again.
+					if (!lock.owns_lock())
+					{
+						lock.lock();
+					}
+					m_wake.wait_for(lock, m_interval, [this] { return m_stopped; });
+				}
+			}
+		}
+	}
+
+	// Counts a write that changed the primary. Must be called under the lock.
+	void written() noexcept
+	{
+		if (++m_written - m_covered >= m_batch)
+		{
+			m_wake.notify_one();
+		}
+	}
+
+  public:
+	// The replica of one group of readers. Its thread runs on_start first,
+	// which may pin it, then copies every new publication and swaps it in.
+	// Lookups never copy. If on_start or the first copy throws, the
+	// constructor rethrows. A later copy that throws is retried, and every
+	// reader rethrows it once. All readers of the group must be destroyed
+	// before it, and all groups before the bimap.
+	struct group
+	{
+	  private:
+		friend replicated_bimap;
+
+		const replicated_bimap* m_owner;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::shared_ptr< const flat_t > m_local;
+		std::atomic< std::uint64_t > m_version;
+		bool m_stopped = false;
+		// The last copy that threw, and how many did.
+		std::exception_ptr m_error;
+		std::atomic< std::uint64_t > m_failures;
+		std::thread m_refresher;
+
+		void unregister() noexcept
+		{
+			std::lock_guard< std::mutex > lock(m_owner->m_published_mutex);
+			std::vector< group* >& groups = m_owner->m_groups;
+			groups.erase(std::find(groups.begin(), groups.end(), this));
+		}
+
+		// Called by the owner under its publication lock.
+		void wake()
+		{
+			{
+				std::lock_guard< std::mutex > lock(m_mutex);
+			}
+			m_wake.notify_one();
+		}
+
+		// Records the exception being handled for the constructor or the
+		// readers to rethrow. Must be called under the lock.
+		void fail() noexcept
+		{
+			m_error = std::current_exception();
+			m_failures.fetch_add(1, std::memory_order_release);
+			m_wake.notify_all();
+		}
+
+		void run_refresher(const std::function< void() >& on_start)
+		{
+			try
+			{
+				if (on_start)
+				{
+					on_start();
+				}
+			} catch (...)
+			{
+				std::lock_guard< std::mutex > lock(m_mutex);
+				fail();
+				return;
+			}
+			std::uint64_t copied = 0;
+			std::unique_lock< std::mutex > lock(m_mutex);
+			while (!m_stopped)
+			{
+				if (m_owner->m_version.load(std::memory_order_acquire) == copied)
+				{
+					m_wake.wait(lock, [&] {
+						return m_stopped || m_owner->m_version.load(std::memory_order_acquire) != copied;
+					});
+					continue;
+				}
+				lock.unlock();
+				std::shared_ptr< const flat_t > published;
+				std::uint64_t version;
+				{
+					std::lock_guard< std::mutex > published_lock(m_owner->m_published_mutex);
+					published = m_owner->m_published;
+					version = m_owner->m_version.load(std::memory_order_relaxed);
+				}
+				std::shared_ptr< const flat_t > local;
+				try
+				{
+					local = std::make_shared< const flat_t >(*published);
+				} catch (...)
+				{
+					lock.lock();
+					fail();
+					if (!m_local)
+					{
+						return;
+					}
+					// Readers keep the previous replica, tries again later.
+					m_wake.wait_for(lock, m_owner->m_interval, [this] { return m_stopped; });
+					continue;
+				}
+				lock.lock();
+				m_local = std::move(local);
+				copied = version;
+				m_version.store(version, std::memory_order_release);
+				m_wake.notify_all();
+			}
+		}
+
+	  public:
+		// Returns once the group holds its first replica.
+		explicit group(const replicated_bimap& owner, std::function< void() > on_start = std::function< void() >()) :
+			m_owner(&owner), m_version(0), m_failures(0)
+		{
+			{
+				std::lock_guard< std::mutex > lock(owner.m_published_mutex);
+				owner.m_groups.push_back(this);
+			}
+			try
+			{
+				m_refresher = std::thread([this, on_start = std::move(on_start)] { run_refresher(on_start); });
+			} catch (...)
+			{
+				unregister();
+				throw;
+			}
+			std::unique_lock< std::mutex > lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_local != nullptr || m_error; });
+			if (!m_local)
+			{
+				lock.unlock();
+				m_refresher.join();
+				unregister();
+				std::rethrow_exception(m_error);
+			}
+		}
+
+		group(const group&) = delete;
+
+		group& operator=(const group&) = delete;
+
+		~group()
+		{
+			unregister();
+			{
+				std::lock_guard< std::mutex > lock(m_mutex);
+				m_stopped = true;
+			}
+			m_wake.notify_all();
+			m_refresher.join();
+		}
+
+		// The version of the group's replica, increasing with every copy.
+		std::uint64_t version() const noexcept { return m_version.load(std::memory_order_acquire); }
+	};
+
+	// A handle to the replica of a group, for one thread at a time.
+	// References returned by lookups stay valid until the next call on the
+	// reader, which may switch to a newer replica in constant time.
+	struct reader
+	{
+	  private:
+		group* m_group;
+		std::shared_ptr< const flat_t > m_local;
+		std::uint64_t m_version = 0;
+		std::uint64_t m_failures = 0;
+
+		// Switches to the group's replica, or rethrows a copy that failed
+		// since the last call and keeps the current one.
+		void refresh()
+		{
+			if (m_group->m_version.load(std::memory_order_acquire) == m_version &&
+				m_group->m_failures.load(std::memory_order_acquire) == m_failures)
+			{
+				return;
+			}
+			std::exception_ptr error;
+			{
+				std::lock_guard< std::mutex > lock(m_group->m_mutex);
+				m_local = m_group->m_local;
+				m_version = m_group->m_version.load(std::memory_order_relaxed);
+				if (m_group->m_failures.load(std::memory_order_relaxed) != m_failures)
+				{
+					m_failures = m_group->m_failures.load(std::memory_order_relaxed);
+					error = m_group->m_error;
+				}
+			}
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+
+	  public:
+		// Starts from the group's replica, failures before are not rethrown.
+		explicit reader(group& owner) : m_group(&owner)
+		{
+			std::lock_guard< std::mutex > lock(m_group->m_mutex);
+			m_local = m_group->m_local;
+			m_version = m_group->m_version.load(std::memory_order_relaxed);
+			m_failures = m_group->m_failures.load(std::memory_order_relaxed);
+		}
+
+		// Returns the opposite element by element.
+		// If the element does not exist, throws std::out_of_range.
+		const right_t& at_left(const left_t& key)
+		{
+			refresh();
+			const std::pair< left_t, right_t >* found = m_local->find_left(key);
+			if (!found)
+			{
+				throw std::out_of_range("No such element was found!");
+			}
+			return found->second;
+		}
+
+		const left_t& at_right(const right_t& key)
+		{
+			refresh();
+			const std::pair< left_t, right_t >* found = m_local->find_right(key);
+			if (!found)
+			{
+				throw std::out_of_range("No such element was found!");
+			}
+			return found->first;
+		}
+
+		bool contains_left(const left_t& key)
+		{
+			refresh();
+			return m_local->find_left(key) != nullptr;
+		}
+
+		bool contains_right(const right_t& key)
+		{
+			refresh();
+			return m_local->find_right(key) != nullptr;
+		}
+
+		// Number of pairs in the replica the reader currently holds.
+		std::size_t size() const noexcept { return m_local->pairs.size(); }
+
+		// The version the reader currently holds, increasing with every
+		// publication.
+		std::uint64_t version() const noexcept { return m_version; }
+	};
+
+	// Publishes after batch writes, or after interval with fewer pending
+	// writes. Zero values are raised to one.
+	explicit replicated_bimap(std::size_t batch = 1 << 10,
+							  std::chrono::milliseconds interval = std::chrono::milliseconds(100),
+							  CompareLeft compare_left = CompareLeft(),
+							  CompareRight compare_right = CompareRight()) :
+		m_primary(compare_left, compare_right), m_batch(std::max< std::size_t >(1, batch)),
+		m_interval(std::max(interval, std::chrono::milliseconds(1))),
+		m_published(std::make_shared< const flat_t >(
+			std::vector< std::pair< left_t, right_t > >(), std::move(compare_left), std::move(compare_right))),
+		m_version(1), m_publisher([this] { run_publisher(); })
+	{
+	}
+
+	replicated_bimap(const replicated_bimap&) = delete;
+
+	replicated_bimap& operator=(const replicated_bimap&) = delete;
+
+	// All readers must be destroyed before.
+	~replicated_bimap()
+	{
+		{
+			std::lock_guard< std::mutex > lock(m_mutex);
+			m_stopped = true;
+		}
+		m_wake.notify_one();
+		m_publisher.join();
+	}
+
+	// Writes to the primary, with the semantics of bimap. They are seen by
+	// readers after the next publication.
+	bool insert(const left_t& left, const right_t& right)
+	{
+		std::lock_guard< std::mutex > lock(m_mutex);
+		if (m_primary.insert(left, right) == m_primary.end_left())
+		{
+			return false;
+		}
+		written();
+		return true;
+	}
+
+	void insert_or_assign(const left_t& left, const right_t& right)
+	{
+		std::lock_guard< std::mutex > lock(m_mutex);
+		m_primary.insert_or_assign(left, right);
+		written();
+	}
+
+	bool erase_left(const left_t& left)
+	{
+		std::lock_guard< std::mutex > lock(m_mutex);
+		if (!m_primary.erase_left(left))
+		{
+			return false;
+		}
+		written();
+		return true;
+	}
+
+	bool erase_right(const right_t& right)
+	{
+		std::lock_guard< std::mutex > lock(m_mutex);
+		if (!m_primary.erase_right(right))
+		{
+			return false;
+		}
+		written();
+		return true;
+	}
+
+	// Publishes pending writes now, on the calling thread.
+	void publish()
+	{
+		std::unique_lock< std::mutex > lock(m_mutex);
+		if (pending())
+		{
+			publish_locked(lock);
+		}
+	}
+
+	// Number of pairs in the primary.
+	std::size_t size()
+	{
+		std::lock_guard< std::mutex > lock(m_mutex);
+		return m_primary.size();
+	}
+};
@@ -0,0 +1,256 @@
+#pragma once
+
+#include "bimap.h"
+#include "bimap_parallel.h"
+
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+// Set operations on the pairs of two bimaps with the same types and
+// comparators. Pairs are compared on both sides, the left sides of the
+// inputs are merge-walked in order and the picked pairs are linked into
+// the result in bulk, like bimap_loader does.
+//
+// With threads > 1 the lefts of both inputs are split into that many
+// slices of about equal size which are merged concurrently, and the right order of the picks
+// is sorted and checked for conflicts in parallel too. Only copying the
+// picked pairs into nodes is left to the calling thread. The inputs are
+// only read, but they must not be modified or looked up concurrently,
+// since lookups splay.
+namespace bimap_details
+{
+	enum class set_operation
+	{
+		union_of,
+		intersection_of,
+		difference_of
+	};
+
+	template< typename Bimap >
+	struct set_merge
+	{
+		using left_iterator = typename Bimap::left_iterator;
+		using right_t = typename Bimap::right_t;
+		using data_t = typename Bimap::data_t;
+
+		// A merged pair, taken from the first or from the second input.
+		struct pick
+		{
+			left_iterator it;
+			bool from_a;
+		};
+
+		static void merge(const Bimap& a,
+						  set_operation op,
+						  left_iterator it_a,
+						  left_iterator last_a,
+						  left_iterator it_b,
+						  left_iterator last_b,
+						  std::vector< pick >& out)
+		{
+			auto cmp_left = a.key_comp_left();
+			auto cmp_right = a.key_comp_right();
+			while (it_a != last_a || it_b != last_b)
+			{
+				if (it_b == last_b || (it_a != last_a && cmp_left(*it_a, *it_b)))
+				{
+					if (op != set_operation::intersection_of)
+					{
+						out.push_back({ it_a, true });
+					}
+					++it_a;
+				}
+				else if (it_a == last_a || cmp_left(*it_b, *it_a))
+				{
+					if (op == set_operation::union_of)
+					{
+						out.push_back({ it_b, false });
+					}
+					++it_b;
+				}
+				else
+				{
+					bool same = !cmp_right(*it_a.flip(), *it_b.flip()) && !cmp_right(*it_b.flip(), *it_a.flip());
+					if (op == set_operation::intersection_of ? same : (op == set_operation::union_of || !same))
+					{
+						out.push_back({ it_a, true });
+					}
+					++it_a;
+					++it_b;
+				}
+			}
+		}
+
+		static Bimap apply(const Bimap& a, const Bimap& b, set_operation op, std::size_t threads)
+		{
+			if (threads < 1)
+			{
+				threads = 1;
+			}
+			std::size_t total = a.size() + b.size();
+			if (threads > total / 2 + 1)
+			{
+				threads = total / 2 + 1;
+			}
+			auto cmp_left = a.key_comp_left();
+			auto cmp_right = a.key_comp_right();
+
+			// Slice borders are picked by rank in the left order of both inputs
+			// by walking them once up front, so the workers only read the trees
+			// and nothing is splayed. Equal lefts stay in one slice.
+			std::vector< left_iterator > borders_a(1, a.begin_left());
+			std::vector< left_iterator > borders_b(1, b.begin_left());
+			left_iterator it_a = a.begin_left();
+			left_iterator it_b = b.begin_left();
+			std::size_t walked = 0;
+			for (std::size_t i = 1; i < threads; i++)
+			{
+				while (walked < total * i / threads)
+				{
+					if (it_b == b.end_left() || (it_a != a.end_left() && cmp_left(*it_a, *it_b)))
+					{
+						++it_a;
+						walked++;
+					}
+					else if (it_a == a.end_left() || cmp_left(*it_b, *it_a))
+					{
+						++it_b;
+						walked++;
+					}
+					else
+					{
+						++it_a;
+						++it_b;
+						walked += 2;
+					}
+				}
+				borders_a.push_back(it_a);
+				borders_b.push_back(it_b);
+			}
+			borders_a.push_back(a.end_left());
+			borders_b.push_back(b.end_left());
+
+			std::vector< std::vector< pick > > parts(threads);
+			run_parallel(threads,
+						 threads,
+						 [&](std::size_t i)
+						 { merge(a, op, borders_a[i], borders_a[i + 1], borders_b[i], borders_b[i + 1], parts[i]); });
+			std::vector< pick > picks;
+			std::size_t count = 0;
+			for (const std::vector< pick >& part : parts)
+			{
+				count += part.size();
+			}
+			picks.reserve(count);
+			for (const std::vector< pick >& part : parts)
+			{
+				picks.insert(picks.end(), part.begin(), part.end());
+			}
+			parts.clear();
+
+			// The nodes are created in left order, their right order is sorted
+			// on the nodes, which lie next to each other in the pool.
+			Bimap res(a.key_comp_left(), a.key_comp_right());
+			std::vector< data_t* > nodes_by_left;
+			try
+			{
+				nodes_by_left.reserve(count);
+				res.m_pool.reserve(count);
+				for (const pick& p : picks)
+				{
+					nodes_by_left.push_back(res.m_pool.create(*p.it, *p.it.flip()));
+				}
+				auto right_of = [&nodes_by_left](std::size_t i) -> const right_t&
+				{ return Bimap::right_of(Bimap::as_right(nodes_by_left[i])); };
+				std::vector< std::size_t > by_right(count);
+				std::iota(by_right.begin(), by_right.end(), 0);
+				parallel_sort(
+					by_right, [&](std::size_t x, std::size_t y) { return cmp_right(right_of(x), right_of(y)); }, threads);
+
+				// A pair of b whose right is used by a pair of a is dropped. A
+				// union picks every pair of a, so the two are neighbours here.
+				std::vector< char > dropped(count);
+				if (op == set_operation::union_of)
+				{
+					run_parallel(threads,
+								 threads,
+								 [&](std::size_t i)
+								 {
+									 for (std::size_t j = count * i / threads; j < count * (i + 1) / threads; j++)
+									 {
+										 std::size_t k = by_right[j];
+										 dropped[k] = !picks[k].from_a &&
+													  ((j > 0 && picks[by_right[j - 1]].from_a &&
+														!cmp_right(right_of(by_right[j - 1]), right_of(k))) ||
+													   (j + 1 < count && picks[by_right[j + 1]].from_a &&
+														!cmp_right(right_of(k), right_of(by_right[j + 1]))));
+									 }
+								 });
+				}
+
+				std::vector< data_t* > nodes_by_right;
+				nodes_by_right.reserve(count);
+				for (std::size_t i : by_right)
+				{
+					if (!dropped[i])
+					{
+						nodes_by_right.push_back(nodes_by_left[i]);
+					}
+				}
+				std::size_t kept = 0;
+				for (std::size_t i = 0; i < count; i++)
+				{
+					if (dropped[i])
+					{
+						res.m_pool.destroy(nodes_by_left[i]);
+					}
+					else
+					{
+						nodes_by_left[kept++] = nodes_by_left[i];
+					}
+				}
+				nodes_by_left.resize(kept);
+				res.link_sorted(nodes_by_left, nodes_by_right);
+			} catch (...)
+			{
+				for (data_t* node : nodes_by_left)
+				{
+					res.m_pool.destroy(node);
+				}
+				throw;
+			}
+			return res;
+		}
+	};
+}	 // namespace bimap_details
+
+// Pairs of a, then pairs of b whose left and right are both not used by a.
+template< typename Lt, typename Rt, typename CLt, typename CRt, typename Sp, typename Fp, typename It >
+bimap< Lt, Rt, CLt, CRt, Sp, Fp, It > bimap_union(const bimap< Lt, Rt, CLt, CRt, Sp, Fp, It >& a,
+												  const bimap< Lt, Rt, CLt, CRt, Sp, Fp, It >& b,
+												  std::size_t threads = 1)
+{
+	using bimap_t = bimap< Lt, Rt, CLt, CRt, Sp, Fp, It >;
+	return bimap_details::set_merge< bimap_t >::apply(a, b, bimap_details::set_operation::union_of, threads);
+}
+
+// Pairs present in both a and b.
+template< typename Lt, typename Rt, typename CLt, typename CRt, typename Sp, typename Fp, typename It >
+bimap< Lt, Rt, CLt, CRt, Sp, Fp, It > bimap_intersection(const bimap< Lt, Rt, CLt, CRt, Sp, Fp, It >& a,
+														 const bimap< Lt, Rt, CLt, CRt, Sp, Fp, It >& b,
+														 std::size_t threads = 1)
+{
+	using bimap_t = bimap< Lt, Rt, CLt, CRt, Sp, Fp, It >;
+	return bimap_details::set_merge< bimap_t >::apply(a, b, bimap_details::set_operation::intersection_of, threads);
+}
+
+// Pairs of a that are not present in b.
+template< typename Lt, typename Rt, typename CLt, typename CRt, typename Sp, typename Fp, typename It >
+bimap< Lt, Rt, CLt, CRt, Sp, Fp, It > bimap_difference(const bimap< Lt, Rt, CLt, CRt, Sp, Fp, It >& a,
+													   const bimap< Lt, Rt, CLt, CRt, Sp, Fp, It >& b,
+													   std::size_t threads = 1)
+{
+	using bimap_t = bimap< Lt, Rt, CLt, CRt, Sp, Fp, It >;
+	return bimap_details::set_merge< bimap_t >::apply(a, b, bimap_details::set_operation::difference_of, threads);
+}
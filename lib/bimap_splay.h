@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+// Splaying strategies of bimap, passed as its last template parameter.
+namespace bimap_splay
+{
+	// The found node climbs to the root through zig, zig-zig and zig-zag
+	// rotations after the search descent.
+	struct bottom_up
+	{
+	};
+
+	// Lookups restructure the tree during the search descent itself, so the
+	// path is walked once. Insertions and erasures still splay bottom-up.
+	struct top_down
+	{
+	};
+
+	// Lookups only move the found node halfway up, which bounds the work of a
+	// single access on a deep node. Insertions and erasures splay fully.
+	struct semi
+	{
+	};
+
+	// Lookups splay only nodes found deeper than Factor * log2(n + 1), so
+	// shallow hits do not touch the tree at all. Insertions and erasures
+	// splay fully.
+	template< std::size_t Factor = 2 >
+	struct depth_limited
+	{
+		static constexpr std::size_t factor = Factor;
+	};
+}	 // namespace bimap_splay
@@ -2,19 +2,43 @@
 
 #include "bimap_comparator.h"
 #include "bimap_element.h"
+#include "bimap_iteration.h"
+#include "bimap_splay.h"
 
+#include <cstddef>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace bimap_details
 {
-	template< typename Key, bool Tree, typename Comparator >
-	struct tree : comparator< Key, Tree, Comparator >
+	template< typename Key,
+			  bool Tree,
+			  typename Comparator,
+			  typename Splay = bimap_splay::bottom_up,
+			  typename Iteration = bimap_iteration::parent_walk >
+	struct tree : comparator< Key, Tree, Comparator, Iteration >
 	{
 	  private:
 		using key_t = Key;
 		using base_t = element_base;
+		using node_t = node_base< Iteration >;
+		using comparator_t = comparator< Key, Tree, Comparator, Iteration >;
 
-		mutable base_t root;
+		static constexpr bool threaded = std::is_same_v< Iteration, bimap_iteration::threaded >;
+
+		mutable node_t root;
+		std::size_t m_size = 0;
+
+		template< typename >
+		struct is_depth_limited : std::false_type
+		{
+		};
+
+		template< std::size_t Factor >
+		struct is_depth_limited< bimap_splay::depth_limited< Factor > > : std::true_type
+		{
+		};
 
 		void zig(element_base* child) const noexcept
 		{
@@ -234,10 +258,239 @@ namespace bimap_details
 			}
 		}
 
+		// Rotates node, found at depth from, up until its depth is at most depth.
+		// The root has depth 0, from may overestimate the actual depth.
+		void splay_partial(base_t* node, std::size_t from, std::size_t depth) const noexcept
+		{
+			if (!depth)
+			{
+				splay(node);
+				return;
+			}
+			while (from > depth && from >= 2 && node->parent != &root && node->parent->parent != &root)
+			{
+				base_t* parent = node->parent;
+				base_t* grand_parent = parent->parent;
+				if ((grand_parent->left == parent && parent->left == node) ||
+					(grand_parent->right == parent && parent->right == node))
+				{
+					zig_zig(node);
+				}
+				else
+				{
+					zig_zag(node);
+				}
+				from -= 2;
+			}
+		}
+
+		// The depth below which depth_limited lookups splay.
+		std::size_t depth_bound() const noexcept
+		{
+			std::size_t log = 0;
+			for (std::size_t n = m_size + 1; n > 1; n >>= 1)
+			{
+				log++;
+			}
+			return Splay::factor * log;
+		}
+
+		// Restructuring after a lookup found node at the given depth.
+		void access(base_t* node, std::size_t depth) const noexcept
+		{
+			if constexpr (std::is_same_v< Splay, bimap_splay::semi >)
+			{
+				splay_partial(node, depth, depth / 2);
+			}
+			else if constexpr (is_depth_limited< Splay >::value)
+			{
+				if (depth > depth_bound())
+				{
+					splay(node);
+				}
+			}
+			else
+			{
+				splay(node);
+			}
+		}
+
+		// Restructuring after a lookup that walked steps links from a finger
+		// instead of descending from the root, reaching node below ancestor.
+		// semi needs the depth of node, which is counted by climbing from
+		// ancestor. depth_limited splays only if the walk itself was longer
+		// than its bound, which is the cost splaying is there to cap.
+		void access_near(base_t* node, const base_t* ancestor, std::size_t steps) const noexcept
+		{
+			if constexpr (std::is_same_v< Splay, bimap_splay::semi >)
+			{
+				std::size_t depth = 0;
+				for (const base_t* up = node; up != ancestor; up = up->parent)
+				{
+					depth++;
+				}
+				for (; ancestor->parent != &root; ancestor = ancestor->parent)
+				{
+					depth++;
+				}
+				access(node, depth);
+			}
+			else
+			{
+				access(node, steps);
+			}
+		}
+
+	  public:
+		// Ranks of the nodes of the tree built by assign_sorted for count
+		// nodes, in breadth-first order.
+		static std::vector< std::size_t > breadth_first(std::size_t count)
+		{
+			std::vector< std::pair< std::size_t, std::size_t > > ranges;
+			std::vector< std::size_t > res;
+			ranges.reserve(2 * count + 1);
+			res.reserve(count);
+			ranges.emplace_back(0, count);
+			for (std::size_t i = 0; i < ranges.size(); i++)
+			{
+				auto [first, size] = ranges[i];
+				if (!size)
+				{
+					continue;
+				}
+				std::size_t middle = size / 2;
+				res.push_back(first + middle);
+				ranges.emplace_back(first, middle);
+				ranges.emplace_back(first + middle + 1, size - middle - 1);
+			}
+			return res;
+		}
+
+	  private:
+		static base_t* build(base_t* const* nodes, std::size_t count, base_t* parent) noexcept
+		{
+			if (!count)
+			{
+				return nullptr;
+			}
+			std::size_t middle = count / 2;
+			base_t* node = nodes[middle];
+			node->parent = parent;
+			node->left = build(nodes, middle, node);
+			node->right = build(nodes + middle + 1, count - middle - 1, node);
+			return node;
+		}
+
+		// Sleator-Tarjan top-down splay: nodes passed on the way down are hung
+		// into the left and right side trees collected under header, which are
+		// joined with the last visited node once the descent stops.
+		base_t* find_top_down(const key_t& to_find, bool flag) const noexcept
+		{
+			base_t* node = root.left;
+			if (!node)
+			{
+				return (flag ? nullptr : &root);
+			}
+
+			base_t header;
+			base_t* left_max = &header;
+			base_t* right_min = &header;
+			bool found = false;
+
+			while (true)
+			{
+				if (comparator_t::operator()(to_find, node))
+				{
+					if (!node->left)
+					{
+						break;
+					}
+					if (comparator_t::operator()(to_find, node->left))
+					{
+						base_t* child = node->left;
+						node->left = child->right;
+						if (child->right)
+						{
+							child->right->parent = node;
+						}
+						child->right = node;
+						node->parent = child;
+						node = child;
+						if (!node->left)
+						{
+							break;
+						}
+					}
+					right_min->left = node;
+					node->parent = right_min;
+					right_min = node;
+					node = node->left;
+				}
+				else if (comparator_t::operator()(node, to_find))
+				{
+					if (!node->right)
+					{
+						break;
+					}
+					if (comparator_t::operator()(node->right, to_find))
+					{
+						base_t* child = node->right;
+						node->right = child->left;
+						if (child->left)
+						{
+							child->left->parent = node;
+						}
+						child->left = node;
+						node->parent = child;
+						node = child;
+						if (!node->right)
+						{
+							break;
+						}
+					}
+					left_max->right = node;
+					node->parent = left_max;
+					left_max = node;
+					node = node->right;
+				}
+				else
+				{
+					found = true;
+					break;
+				}
+			}
+
+			left_max->right = node->left;
+			if (node->left)
+			{
+				node->left->parent = left_max;
+			}
+			right_min->left = node->right;
+			if (node->right)
+			{
+				node->right->parent = right_min;
+			}
+			node->left = header.right;
+			node->right = header.left;
+			if (node->left)
+			{
+				node->left->parent = node;
+			}
+			if (node->right)
+			{
+				node->right->parent = node;
+			}
+			node->parent = &root;
+			root.left = node;
+
+			return (found || !flag ? node : nullptr);
+		}
+
 	  public:
 		void swap(tree& other) noexcept
 		{
-			std::swap(root, other.root);
+			std::swap(root.left, other.root.left);
+			std::swap(m_size, other.m_size);
 
 			if (root.left)
 			{
@@ -248,29 +501,41 @@ namespace bimap_details
 			{
 				other.root.left->parent = &(other.root);
 			}
+			if constexpr (threaded)
+			{
+				root.exchange_threads(other.root);
+			}
 
-			std::swap(static_cast< comparator< Key, Tree, Comparator >& >(*this),
-					  static_cast< comparator< Key, Tree, Comparator >& >(other));
+			std::swap(static_cast< comparator_t& >(*this), static_cast< comparator_t& >(other));
 		}
 
-		tree(const comparator< Key, Tree, Comparator >& cmp) : comparator< Key, Tree, Comparator >(cmp) {}
-
-		tree(comparator< Key, Tree, Comparator >&& cmp) noexcept : comparator< Key, Tree, Comparator >(std::move(cmp))
-		{
-		}
+		tree(const comparator_t& cmp) : comparator_t(cmp) {}
 
-		tree(Comparator&& cmp) noexcept : comparator< Key, Tree, Comparator >(std::move(cmp)) {}
+		tree(comparator_t&& cmp) noexcept : comparator_t(std::move(cmp)) {}
 
-		tree(tree&& other) noexcept :
-			comparator< Key, Tree, Comparator >(std::move(static_cast< comparator< Key, Tree, Comparator >&& >(other))),
-			root(std::move(other.root))
+		tree(Comparator&& cmp) noexcept : comparator_t(std::move(cmp)) {}
 
+		tree(tree&& other) noexcept : comparator_t(std::move(static_cast< comparator_t&& >(other)))
 		{
+			std::swap(root.left, other.root.left);
+			std::swap(m_size, other.m_size);
+			if (root.left)
+			{
+				root.left->parent = &root;
+			}
+			if constexpr (threaded)
+			{
+				root.exchange_threads(other.root);
+			}
 		}
 
 		base_t* begin() const noexcept
 		{
-			if (root.left)
+			if constexpr (threaded)
+			{
+				return root.succ;
+			}
+			else if (root.left)
 			{
 				splay(root.min(root.left));
 				return root.left;
@@ -283,34 +548,129 @@ namespace bimap_details
 
 		base_t* end() const noexcept { return &root; }
 
+		// Same as begin, but leaves the tree as it is.
+		base_t* leftmost() const noexcept { return (root.left ? root.min(root.left) : &root); }
+
+		std::size_t size() const noexcept { return m_size; }
+
 		void set_another_tree(base_t* another_tree) noexcept { root.right = another_tree; }
 
 		base_t* find(const key_t& to_find, bool flag = true) const noexcept
 		{
+			if constexpr (std::is_same_v< Splay, bimap_splay::top_down >)
+			{
+				return find_top_down(to_find, flag);
+			}
+
 			base_t* transfer_prev = &root;
 			base_t* transfer = root.left;
+			std::size_t depth = 0;
 
 			while (transfer)
 			{
 				transfer_prev = transfer;
-				if (comparator< Key, Tree, Comparator >::operator()(to_find, transfer))
+				if (comparator_t::operator()(to_find, transfer))
 				{
 					transfer = transfer->left;
 				}
-				else if (comparator< Key, Tree, Comparator >::operator()(transfer, to_find))
+				else if (comparator_t::operator()(transfer, to_find))
 				{
 					transfer = transfer->right;
 				}
 				else
 				{
-					splay(transfer);
+					access(transfer, depth);
 					return transfer;
 				}
+				depth++;
 			}
 
 			return (flag ? nullptr : transfer_prev);
 		}
 
+		// Looks the key up starting from a linked node: climbs only until the
+		// subtree can hold the key, then descends. There is no bound in the
+		// rank distance between finger and the key for a single walk: on a
+		// path-shaped tree the climb is linear in it. It helps when the key
+		// is close to a deep finger, which depth_limited leaves in place.
+		base_t* find_near(base_t* finger, const key_t& to_find) const noexcept
+		{
+			if (finger == &root)
+			{
+				return find(to_find);
+			}
+
+			base_t* node = finger;
+			std::size_t steps = 0;
+			bool toward_left = comparator_t::operator()(to_find, node);
+			if (!toward_left && !comparator_t::operator()(node, to_find))
+			{
+				access_near(node, node, steps);
+				return node;
+			}
+
+			// On a climb from a left child to the left (or from a right child to
+			// the right) the parent bounds the subtree on the far side already.
+			while (node->parent != &root)
+			{
+				base_t* parent = node->parent;
+				bool from_left = (parent->left == node);
+				if (from_left != toward_left)
+				{
+					if (toward_left ? !comparator_t::operator()(to_find, parent) : !comparator_t::operator()(parent, to_find))
+					{
+						if (toward_left ? !comparator_t::operator()(parent, to_find) : !comparator_t::operator()(to_find, parent))
+						{
+							access_near(parent, parent, steps + 1);
+							return parent;
+						}
+						break;
+					}
+				}
+				node = parent;
+				steps++;
+			}
+
+			const base_t* ancestor = node;
+			while (node)
+			{
+				if (comparator_t::operator()(to_find, node))
+				{
+					node = node->left;
+				}
+				else if (comparator_t::operator()(node, to_find))
+				{
+					node = node->right;
+				}
+				else
+				{
+					access_near(node, ancestor, steps);
+					return node;
+				}
+				steps++;
+			}
+			return nullptr;
+		}
+
+		// Links a new leaf, the child of parent on the given side, into the
+		// in-order list. Nothing to do unless iteration is threaded.
+		static void thread([[maybe_unused]] base_t* node, [[maybe_unused]] base_t* parent, [[maybe_unused]] bool left) noexcept
+		{
+			if constexpr (threaded)
+			{
+				node_t* linked = static_cast< node_t* >(node);
+				node_t* neighbour = static_cast< node_t* >(parent);
+				if (left)
+				{
+					linked->thread_between(neighbour->pred, neighbour);
+				}
+				else
+				{
+					linked->thread_between(neighbour, neighbour->succ);
+				}
+			}
+		}
+
 		base_t* insert(base_t* inserted)
 		{
 			base_t* transfer_parent = &root;
@@ -319,7 +679,7 @@ namespace bimap_details
 			while (transfer)
 			{
 				transfer_parent = transfer;
-				if (comparator< Key, Tree, Comparator >::operator()(inserted, transfer))
+				if (comparator_t::operator()(inserted, transfer))
 				{
 					transfer = transfer->left;
 				}
@@ -330,18 +690,22 @@ namespace bimap_details
 			}
 
 			inserted->parent = transfer_parent;
+			m_size++;
 
 			if (transfer_parent == &root)
 			{
 				root.left = inserted;
+				thread(inserted, transfer_parent, true);
 			}
-			else if (comparator< Key, Tree, Comparator >::operator()(transfer_parent, inserted))
+			else if (comparator_t::operator()(inserted, transfer_parent))
 			{
-				transfer_parent->right = inserted;
+				transfer_parent->left = inserted;
+				thread(inserted, transfer_parent, true);
 			}
 			else
 			{
-				transfer_parent->left = inserted;
+				transfer_parent->right = inserted;
+				thread(inserted, transfer_parent, false);
 			}
 
 			splay(inserted);
@@ -353,10 +717,8 @@ namespace bimap_details
 		{
 			base_t* found = find(value, false);
 
-			if (found == end() ||
-				(!comparator< Key, Tree, Comparator >::operator()(value, found) &&
-				 !comparator< Key, Tree, Comparator >::operator()(found, value)) ||
-				comparator< Key, Tree, Comparator >::operator()(value, found))
+			if (found == end() || (!comparator_t::operator()(value, found) && !comparator_t::operator()(found, value)) ||
+				comparator_t::operator()(value, found))
 			{
 				return found;
 			}
@@ -368,7 +730,7 @@ namespace bimap_details
 		{
 			base_t* found = find(value, false);
 
-			if (found == end() || comparator< Key, Tree, Comparator >::operator()(value, found))
+			if (found == end() || comparator_t::operator()(value, found))
 			{
 				return found;
 			}
@@ -376,12 +738,186 @@ namespace bimap_details
 			return found->next(found);
 		}
 
+		// Finds lower bound of from and upper bound of to in one descent, which
+		// only forks where the two searches part. Requires !(to < from). The
+		// lower bound is restructured like a found node. Under top_down from
+		// is splayed top-down first, and both bounds are looked up below.
+		void bounds(const key_t& from, const key_t& to, base_t*& first, base_t*& last) const noexcept
+		{
+			first = &root;
+			last = &root;
+			if constexpr (std::is_same_v< Splay, bimap_splay::top_down >)
+			{
+				find_top_down(from, false);
+				for (base_t* lower = root.left; lower;)
+				{
+					if (comparator_t::operator()(lower, from))
+					{
+						lower = lower->right;
+					}
+					else
+					{
+						first = lower;
+						lower = lower->left;
+					}
+				}
+				for (base_t* upper = root.left; upper;)
+				{
+					if (comparator_t::operator()(to, upper))
+					{
+						last = upper;
+						upper = upper->left;
+					}
+					else
+					{
+						upper = upper->right;
+					}
+				}
+				return;
+			}
+
+			base_t* node = root.left;
+			std::size_t depth = 0;
+			std::size_t first_depth = 0;
+
+			while (node)
+			{
+				if (comparator_t::operator()(node, from))
+				{
+					node = node->right;
+				}
+				else if (comparator_t::operator()(to, node))
+				{
+					first = node;
+					last = node;
+					first_depth = depth;
+					node = node->left;
+				}
+				else
+				{
+					break;
+				}
+				depth++;
+			}
+
+			if (node)
+			{
+				first = node;
+				first_depth = depth;
+				for (base_t* lower = node->left; lower;)
+				{
+					depth++;
+					if (comparator_t::operator()(lower, from))
+					{
+						lower = lower->right;
+					}
+					else
+					{
+						first = lower;
+						first_depth = depth;
+						lower = lower->left;
+					}
+				}
+				for (base_t* upper = node->right; upper;)
+				{
+					if (comparator_t::operator()(to, upper))
+					{
+						last = upper;
+						upper = upper->left;
+					}
+					else
+					{
+						upper = upper->right;
+					}
+				}
+			}
+
+			if (first != &root)
+			{
+				access(first, first_depth);
+			}
+		}
+
+		// Where a key absent from the tree would be linked.
+		struct position
+		{
+			base_t* parent;
+			bool left;
+		};
+
+		// Looks the key up without splaying. Returns the equivalent node, or
+		// nullptr and the position for the key.
+		base_t* locate(const key_t& key, position& pos) const noexcept
+		{
+			pos.parent = &root;
+			pos.left = true;
+			for (base_t* node = root.left; node;)
+			{
+				pos.parent = node;
+				if (comparator_t::operator()(key, node))
+				{
+					pos.left = true;
+					node = node->left;
+				}
+				else if (comparator_t::operator()(node, key))
+				{
+					pos.left = false;
+					node = node->right;
+				}
+				else
+				{
+					return node;
+				}
+			}
+			return nullptr;
+		}
+
+		// Links an unlinked node at a position found by locate.
+		void attach(base_t* node, const position& pos) noexcept
+		{
+			node->parent = pos.parent;
+			(pos.left ? pos.parent->left : pos.parent->right) = node;
+			thread(node, pos.parent, pos.left);
+			m_size++;
+			splay(node);
+		}
+
+		// Moves a linked node to a position found by locate while it was
+		// linked. A placeholder keeps the position while node is unlinked, so
+		// no comparisons are made and the key of node may already be the one
+		// of the new position.
+		void move_to(base_t* node, const position& pos) noexcept
+		{
+			node_t hole;
+			hole.parent = pos.parent;
+			(pos.left ? pos.parent->left : pos.parent->right) = &hole;
+			thread(&hole, pos.parent, pos.left);
+			erase(node);
+			static_cast< node_t* >(node)->swap(hole);
+			m_size++;
+			splay(node);
+		}
+
+		// Puts a linked node in place of victim, which gets unlinked.
+		void take_place(base_t* node, base_t* victim) noexcept
+		{
+			erase(node);
+			static_cast< node_t* >(node)->swap(*static_cast< node_t* >(victim));
+			splay(node);
+		}
+
 		void erase(base_t* node) noexcept
 		{
+			m_size--;
 			splay(node);
 			root.left = merge(node->left, node->right);
 			node->left = nullptr;
 			node->right = nullptr;
+			node->parent = nullptr;
+			if constexpr (threaded)
+			{
+				static_cast< node_t* >(node)->unthread();
+			}
 
 			if (root.left)
 			{
@@ -389,14 +925,89 @@ namespace bimap_details
 			}
 		}
 
+		// Links unlinked nodes, given in increasing order of distinct keys, into
+		// a perfectly balanced tree. The previous nodes of the tree, if any,
+		// are forgotten.
+		void assign_sorted(base_t* const* nodes, std::size_t count) noexcept
+		{
+			root.left = build(nodes, count, &root);
+			m_size = count;
+			if constexpr (threaded)
+			{
+				root.pred = &root;
+				root.succ = &root;
+				for (std::size_t i = 0; i < count; i++)
+				{
+					static_cast< node_t* >(nodes[i])->thread_between(root.pred, &root);
+				}
+			}
+		}
+
+		bool is_less(const key_t& a, const key_t& b) const noexcept
+		{
+			return comparator_t::operator()(a, b);
+		}
+
 		bool is_equals(const key_t& a, const key_t& b) const noexcept
 		{
-			return !comparator< Key, Tree, Comparator >::operator()(a, b) && !comparator< Key, Tree, Comparator >::operator()(b, a);
+			return !comparator_t::operator()(a, b) && !comparator_t::operator()(b, a);
+		}
+
+		const comparator_t& get_comparator() const noexcept
+		{
+			return static_cast< comparator_t const & >(*this);
+		}
+
+		// Whether node is linked into this tree, by climbing to the sentinel.
+		bool holds(base_t* node) const noexcept
+		{
+			while (node->parent)
+			{
+				node = node->parent;
+			}
+			return node == &root;
 		}
 
-		const comparator< Key, Tree, Comparator >& get_comparator() const noexcept
+		// Checks the links, the order of keys and the size by a linear walk
+		// that does not splay. Equal neighbours are allowed unless unique.
+		// Meant for debugging and randomized testing.
+		bool check_invariants(bool unique = true) const noexcept
 		{
-			return static_cast< comparator< Key, Tree, Comparator > const & >(*this);
+			if (root.parent || !root.right || (root.left && root.left->parent != &root))
+			{
+				return false;
+			}
+			std::size_t count = 0;
+			base_t* previous = nullptr;
+			for (base_t* node = leftmost(); node != &root; node = node->next(node))
+			{
+				if (++count > m_size || (node->left && node->left->parent != node) ||
+					(node->right && node->right->parent != node))
+				{
+					return false;
+				}
+				if (previous && (comparator_t::operator()(node, previous) || (unique && !comparator_t::operator()(previous, node))))
+				{
+					return false;
+				}
+				if constexpr (threaded)
+				{
+					node_t* linked = static_cast< node_t* >(node);
+					if (linked->pred != (previous ? previous : &root) || linked->pred->succ != linked)
+					{
+						return false;
+					}
+				}
+				previous = node;
+			}
+			if constexpr (threaded)
+			{
+				if (root.pred != (previous ? previous : &root) || root.pred->succ != &root)
+				{
+					return false;
+				}
+			}
+			return count == m_size;
 		}
 	};
 }	 // namespace bimap_details
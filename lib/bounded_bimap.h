@@ -0,0 +1,527 @@
+#pragma once
+
+#include "bimap.h"
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Which pair a full bounded_bimap drops to make room for a new one.
+namespace bimap_eviction
+{
+	// The least recently used pair.
+	struct lru
+	{
+	};
+
+	// The least frequently used pair, the least recently used one among
+	// equally frequent pairs.
+	struct lfu
+	{
+	};
+}	 // namespace bimap_eviction
+
+namespace bimap_details
+{
+	template< typename Node >
+	struct use_bucket;
+
+	// A pair of bounded_bimap, also linked into the bucket of its use count.
+	template< typename Left, typename Right, typename Iteration >
+	struct use_node : element_data< Left, Right, Iteration >
+	{
+		// Neighbours in the bucket, prev is less recently used.
+		use_node* prev = nullptr;
+		use_node* next = nullptr;
+		use_bucket< use_node >* owner = nullptr;
+
+		template< typename left_t_f, typename right_t_f >
+		use_node(left_t_f&& left, right_t_f&& right) :
+			element_data< Left, Right, Iteration >(std::forward< left_t_f >(left), std::forward< right_t_f >(right))
+		{
+		}
+	};
+
+	// Pairs used the same number of times, from the least recently used.
+	// Spare buckets are chained through next.
+	template< typename Node >
+	struct use_bucket
+	{
+		std::size_t uses = 1;
+		use_bucket* prev = nullptr;
+		use_bucket* next = nullptr;
+		Node* first = nullptr;
+		Node* last = nullptr;
+	};
+}	 // namespace bimap_details
+
+// A bimap of at most capacity pairs, usable as a bidirectional cache.
+// Inserting into a full bounded_bimap evicts a pair chosen by Eviction.
+// Lookups by find and at count as uses of the pair and cost the same as in
+// bimap; the use bookkeeping and the eviction are O(1).
+//
+// Every node is also linked into a list ordered by use. With lfu the list
+// is split into buckets of equal use count, kept in increasing count order.
+// The buckets are preallocated on insertion, one per pair, so lookups do not
+// allocate.
+template< typename Left,
+		  typename Right,
+		  typename CompareLeft = std::less< Left >,
+		  typename CompareRight = std::less< Right >,
+		  typename Eviction = bimap_eviction::lru,
+		  typename Splay = bimap_splay::bottom_up,
+		  typename Iteration = bimap_iteration::parent_walk >
+struct bounded_bimap :
+	bimap_details::bimap_base< bounded_bimap< Left, Right, CompareLeft, CompareRight, Eviction, Splay, Iteration >,
+							   Left,
+							   Right,
+							   CompareLeft,
+							   CompareRight,
+							   Splay,
+							   Iteration,
+							   bimap_details::use_node< Left, Right, Iteration > >
+{
+  private:
+	using node = bimap_details::use_node< Left, Right, Iteration >;
+	using bucket = bimap_details::use_bucket< node >;
+	using base = bimap_details::bimap_base< bounded_bimap, Left, Right, CompareLeft, CompareRight, Splay, Iteration, node >;
+
+  public:
+	using typename base::left_t;
+	using typename base::right_t;
+	using typename base::left_iterator;
+	using typename base::right_iterator;
+
+	// Counters since construction or the last reset_statistics().
+	struct statistics
+	{
+		// Lookups by find and at that found or did not find the key.
+		std::size_t hits = 0;
+		std::size_t misses = 0;
+		std::size_t insertions = 0;
+		std::size_t evictions = 0;
+	};
+
+  private:
+	using typename base::base_t;
+	using typename base::left_position;
+	using typename base::right_position;
+
+	using base::m_count;
+	using base::m_pool;
+	using base::m_left_tree;
+	using base::m_right_tree;
+
+	using base::as_left;
+	using base::as_right;
+	using base::node_of_left;
+	using base::node_of_right;
+	using base::left_of;
+	using base::right_of;
+	using base::clear;
+
+	static constexpr bool counts_uses = std::is_same_v< Eviction, bimap_eviction::lfu >;
+
+	std::size_t m_capacity;
+	statistics m_statistics;
+	bimap_details::node_pool< bucket > m_bucket_pool;
+	// Buckets in increasing order of uses, and spare buckets. There are
+	// always as many buckets in both lists together as there are pairs.
+	bucket* m_lowest = nullptr;
+	bucket* m_spare = nullptr;
+
+	// Makes a spare bucket for a pair about to be added.
+	void reserve_bucket()
+	{
+		bucket* spare = m_bucket_pool.create();
+		spare->next = m_spare;
+		m_spare = spare;
+	}
+
+	// Releases a spare bucket after a pair was removed.
+	void release_bucket() noexcept
+	{
+		bucket* spare = m_spare;
+		m_spare = spare->next;
+		m_bucket_pool.destroy(spare);
+	}
+
+	// Puts a spare bucket with the given uses after the bucket after, or
+	// first if after is nullptr.
+	bucket* open_bucket(std::size_t uses, bucket* after) noexcept
+	{
+		bucket* b = m_spare;
+		m_spare = b->next;
+		b->uses = uses;
+		b->prev = after;
+		b->next = (after ? after->next : m_lowest);
+		b->first = nullptr;
+		b->last = nullptr;
+		if (b->next)
+		{
+			b->next->prev = b;
+		}
+		(after ? after->next : m_lowest) = b;
+		return b;
+	}
+
+	// Appends elem to b as its most recently used pair.
+	static void enter(node* elem, bucket* b) noexcept
+	{
+		elem->owner = b;
+		elem->prev = b->last;
+		elem->next = nullptr;
+		(b->last ? b->last->next : b->first) = elem;
+		b->last = elem;
+	}
+
+	// Unlinks elem from its bucket. A bucket left empty becomes spare.
+	// Returns the bucket after which a bucket of the next uses count belongs.
+	bucket* leave(node* elem) noexcept
+	{
+		bucket* b = elem->owner;
+		(elem->prev ? elem->prev->next : b->first) = elem->next;
+		(elem->next ? elem->next->prev : b->last) = elem->prev;
+		if (b->first)
+		{
+			return b;
+		}
+		bucket* before = b->prev;
+		(before ? before->next : m_lowest) = b->next;
+		if (b->next)
+		{
+			b->next->prev = before;
+		}
+		b->next = m_spare;
+		m_spare = b;
+		return before;
+	}
+
+	// Records a use of elem.
+	void touch(node* elem) noexcept
+	{
+		bucket* from = elem->owner;
+		if constexpr (!counts_uses)
+		{
+			if (from->last != elem)
+			{
+				leave(elem);
+				enter(elem, from);
+			}
+		}
+		else
+		{
+			std::size_t uses = from->uses + 1;
+			bucket* to = from->next;
+			if (from->first == elem && from->last == elem && !(to && to->uses == uses))
+			{
+				from->uses = uses;
+				return;
+			}
+			bucket* before = leave(elem);
+			enter(elem, (to && to->uses == uses) ? to : open_bucket(uses, before));
+		}
+	}
+
+	// Links a new pair as used once.
+	void enter_new(node* elem) noexcept
+	{
+		enter(elem, (m_lowest && m_lowest->uses == 1) ? m_lowest : open_bucket(1, nullptr));
+	}
+
+	void erase_impl(node* elem) noexcept
+	{
+		m_count--;
+		leave(elem);
+		m_left_tree.erase(as_left(elem));
+		m_right_tree.erase(as_right(elem));
+		m_pool.destroy(elem);
+		release_bucket();
+	}
+
+	// The node is created and its bucket reserved before anything is
+	// evicted, so a throwing insertion leaves the bimap unchanged.
+	template< typename left_t_f = left_t, typename right_t_f = right_t >
+	left_iterator insert_impl(left_t_f&& left, right_t_f&& right)
+	{
+		left_position left_pos;
+		right_position right_pos;
+		if (m_left_tree.locate(left, left_pos) || m_right_tree.locate(right, right_pos))
+		{
+			return end_left();
+		}
+		node* elem = m_pool.create(std::forward< left_t_f >(left), std::forward< right_t_f >(right));
+		try
+		{
+			reserve_bucket();
+		} catch (...)
+		{
+			m_pool.destroy(elem);
+			throw;
+		}
+		if (m_count == m_capacity)
+		{
+			erase_impl(m_lowest->first);
+			m_statistics.evictions++;
+			m_left_tree.locate(left_of(as_left(elem)), left_pos);
+			m_right_tree.locate(right_of(as_right(elem)), right_pos);
+		}
+		m_count++;
+		m_statistics.insertions++;
+		m_left_tree.attach(as_left(elem), left_pos);
+		m_right_tree.attach(as_right(elem), right_pos);
+		enter_new(elem);
+		return left_iterator(as_left(elem));
+	}
+
+  public:
+	using base::erase_left;
+	using base::erase_right;
+	using base::begin_left;
+	using base::end_left;
+	using base::begin_right;
+	using base::end_right;
+	using base::empty;
+	using base::size;
+
+	void swap(bounded_bimap& other) noexcept
+	{
+		base::swap(other);
+		std::swap(m_capacity, other.m_capacity);
+		std::swap(m_statistics, other.m_statistics);
+		m_bucket_pool.swap(other.m_bucket_pool);
+		std::swap(m_lowest, other.m_lowest);
+		std::swap(m_spare, other.m_spare);
+	}
+
+	// Creates an empty bounded_bimap that holds at most capacity pairs.
+	// A capacity of zero throws std::invalid_argument.
+	explicit bounded_bimap(std::size_t capacity,
+						   CompareLeft compare_left = CompareLeft(),
+						   CompareRight compare_right = CompareRight()) :
+		base(std::move(compare_left), std::move(compare_right)), m_capacity(capacity)
+	{
+		if (!capacity)
+		{
+			throw std::invalid_argument("Capacity must be positive!");
+		}
+	}
+
+	// Copies the pairs together with their uses and recency, but not the
+	// statistics.
+	bounded_bimap(const bounded_bimap& other) : base(other), m_capacity(other.m_capacity)
+	{
+		try
+		{
+			bucket* last = nullptr;
+			for (bucket* b = other.m_lowest; b; b = b->next)
+			{
+				for (node* elem = b->first; elem; elem = elem->next)
+				{
+					node* copy = m_pool.create(left_of(as_left(elem)), right_of(as_right(elem)));
+					try
+					{
+						reserve_bucket();
+					} catch (...)
+					{
+						m_pool.destroy(copy);
+						throw;
+					}
+					m_count++;
+					m_left_tree.insert(as_left(copy));
+					m_right_tree.insert(as_right(copy));
+					if (!last || last->uses != b->uses)
+					{
+						last = open_bucket(b->uses, last);
+					}
+					enter(copy, last);
+				}
+			}
+		} catch (...)
+		{
+			clear();
+			throw;
+		}
+	}
+
+	bounded_bimap(bounded_bimap&& other) noexcept :
+		base(std::move(other)), m_capacity(other.m_capacity), m_statistics(other.m_statistics),
+		m_bucket_pool(std::move(other.m_bucket_pool)), m_lowest(other.m_lowest), m_spare(other.m_spare)
+	{
+		other.m_lowest = nullptr;
+		other.m_spare = nullptr;
+	}
+
+	bounded_bimap& operator=(const bounded_bimap& other)
+	{
+		if (this != std::addressof(other))
+		{
+			bounded_bimap(other).swap(*this);
+		}
+		return *this;
+	}
+
+	bounded_bimap& operator=(bounded_bimap&& other) noexcept
+	{
+		if (this != std::addressof(other))
+		{
+			bounded_bimap(std::move(other)).swap(*this);
+		}
+		return *this;
+	}
+
+	// Invalidates all iterators referencing elements of this bounded_bimap.
+	~bounded_bimap() { clear(); }
+
+	// Insert a pair (left, right), returns an iterator to left.
+	// If such left or such right already exists, no insertion occurs and
+	// end_left() is returned. Otherwise, if the bimap is full, a pair is
+	// evicted first, which invalidates iterators to it.
+	left_iterator insert(const left_t& left, const right_t& right) { return insert_impl(left, right); }
+
+	left_iterator insert(const left_t& left, right_t&& right) { return insert_impl(left, std::move(right)); }
+
+	left_iterator insert(left_t&& left, const right_t& right) { return insert_impl(std::move(left), right); }
+
+	left_iterator insert(left_t&& left, right_t&& right) { return insert_impl(std::move(left), std::move(right)); }
+
+	// Removes an element and its pair, returns an iterator to the next one.
+	left_iterator erase_left(left_iterator it) noexcept
+	{
+		left_iterator res(std::next(it));
+		erase_impl(node_of_left(it.value));
+		return res;
+	}
+
+	right_iterator erase_right(right_iterator it) noexcept
+	{
+		right_iterator res(std::next(it));
+		erase_impl(node_of_right(it.value));
+		return res;
+	}
+
+	// Removes the pair with the key if present, returns whether it was.
+	bool erase_left(const left_t& left) noexcept
+	{
+		base_t* found = m_left_tree.find(left);
+		if (found)
+		{
+			erase_impl(node_of_left(found));
+		}
+		return found != nullptr;
+	}
+
+	bool erase_right(const right_t& right) noexcept
+	{
+		base_t* found = m_right_tree.find(right);
+		if (found)
+		{
+			erase_impl(node_of_right(found));
+		}
+		return found != nullptr;
+	}
+
+	// Returns an iterator over the element and records a use of its pair.
+	// If not found, the corresponding end().
+	left_iterator find_left(const left_t& left) noexcept
+	{
+		base_t* found = m_left_tree.find(left);
+		if (!found)
+		{
+			m_statistics.misses++;
+			return end_left();
+		}
+		m_statistics.hits++;
+		touch(node_of_left(found));
+		return left_iterator(found);
+	}
+
+	right_iterator find_right(const right_t& right) noexcept
+	{
+		base_t* found = m_right_tree.find(right);
+		if (!found)
+		{
+			m_statistics.misses++;
+			return end_right();
+		}
+		m_statistics.hits++;
+		touch(node_of_right(found));
+		return right_iterator(found);
+	}
+
+	// Returns the opposite element and records a use of the pair.
+	// If the element does not exist, throws std::out_of_range.
+	const right_t& at_left(const left_t& key)
+	{
+		left_iterator found = find_left(key);
+		if (found == end_left())
+		{
+			throw std::out_of_range("No such element was found!");
+		}
+		return *found.flip();
+	}
+
+	const left_t& at_right(const right_t& key)
+	{
+		right_iterator found = find_right(key);
+		if (found == end_right())
+		{
+			throw std::out_of_range("No such element was found!");
+		}
+		return *found.flip();
+	}
+
+	// Whether the key is present. Not a use and not counted.
+	bool contains_left(const left_t& left) const noexcept
+	{
+		left_position pos;
+		return m_left_tree.locate(left, pos) != nullptr;
+	}
+
+	bool contains_right(const right_t& right) const noexcept
+	{
+		right_position pos;
+		return m_right_tree.locate(right, pos) != nullptr;
+	}
+
+	// The pair that the next insertion into the full bimap would evict.
+	// end_left() if the bimap is empty.
+	left_iterator victim() const noexcept { return (m_lowest ? left_iterator(as_left(m_lowest->first)) : end_left()); }
+
+	// Checks both trees, that every pair is reachable from both sides and
+	// that the use buckets are ordered and hold every pair exactly once.
+	// Linear-logarithmic and does not splay, meant for debugging and
+	// randomized testing.
+	bool check_invariants() const noexcept
+	{
+		if (!base::check_links(true))
+		{
+			return false;
+		}
+		std::size_t count = 0;
+		for (bucket* b = m_lowest; b; b = b->next)
+		{
+			if (!b->first || (b->next && (b->next->prev != b || b->next->uses <= b->uses)))
+			{
+				return false;
+			}
+			for (node* elem = b->first; elem; elem = elem->next)
+			{
+				if (++count > m_count || elem->owner != b || (elem->next ? elem->next->prev != elem : b->last != elem) ||
+					!m_left_tree.holds(as_left(elem)))
+				{
+					return false;
+				}
+			}
+		}
+		return count == m_count && m_count <= m_capacity;
+	}
+
+	const statistics& get_statistics() const noexcept { return m_statistics; }
+
+	void reset_statistics() noexcept { m_statistics = statistics(); }
+
+	std::size_t capacity() const noexcept { return m_capacity; }
+};
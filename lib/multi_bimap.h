@@ -0,0 +1,288 @@
+#pragma once
+
+#include "bimap.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// A set of pairs in which both lefts and rights may repeat, that is a
+// many-to-many relation. Each pair is stored once, in a node linked into
+// both trees like in bimap. Equivalent keys are ordered by insertion.
+template< typename Left,
+		  typename Right,
+		  typename CompareLeft = std::less< Left >,
+		  typename CompareRight = std::less< Right >,
+		  typename Splay = bimap_splay::bottom_up,
+		  typename Iteration = bimap_iteration::parent_walk >
+struct multi_bimap :
+	bimap_details::bimap_base< multi_bimap< Left, Right, CompareLeft, CompareRight, Splay, Iteration >,
+							   Left,
+							   Right,
+							   CompareLeft,
+							   CompareRight,
+							   Splay,
+							   Iteration >
+{
+  private:
+	using base = bimap_details::bimap_base< multi_bimap, Left, Right, CompareLeft, CompareRight, Splay, Iteration >;
+
+  public:
+	using typename base::left_t;
+	using typename base::right_t;
+	using typename base::left_iterator;
+	using typename base::right_iterator;
+
+	using left_range =
+		typename bimap< Left, Right, CompareLeft, CompareRight, Splay, bimap_fingerprint::none, Iteration >::left_range;
+	using right_range =
+		typename bimap< Left, Right, CompareLeft, CompareRight, Splay, bimap_fingerprint::none, Iteration >::right_range;
+
+  private:
+	using typename base::base_t;
+	using typename base::data_t;
+
+	using base::m_count;
+	using base::m_pool;
+	using base::m_left_tree;
+	using base::m_right_tree;
+
+	using base::as_left;
+	using base::as_right;
+	using base::node_of_left;
+	using base::node_of_right;
+	using base::clear;
+
+	template< typename left_t_f = left_t, typename right_t_f = right_t >
+	left_iterator insert_impl(left_t_f&& left, right_t_f&& right)
+	{
+		if (contains(left, right))
+		{
+			return end_left();
+		}
+		data_t* elem = m_pool.create(std::forward< left_t_f >(left), std::forward< right_t_f >(right));
+		m_count++;
+		base_t* inserted = m_left_tree.insert(as_left(elem));
+		m_right_tree.insert(as_right(elem));
+		return left_iterator(inserted);
+	}
+
+	void erase_impl(base_t* left_to_delete, base_t* right_to_delete) noexcept
+	{
+		m_count--;
+		m_left_tree.erase(left_to_delete);
+		m_right_tree.erase(right_to_delete);
+		m_pool.destroy(base::node_of_left(left_to_delete));
+	}
+
+  public:
+	using base::erase_left;
+	using base::erase_right;
+	using base::begin_left;
+	using base::end_left;
+	using base::begin_right;
+	using base::end_right;
+	using base::empty;
+	using base::size;
+
+	void swap(multi_bimap& other) noexcept { base::swap(other); }
+
+	// Creates a multi_bimap that does not contain any pairs.
+	multi_bimap(CompareLeft compare_left = CompareLeft(), CompareRight compare_right = CompareRight()) :
+		base(std::move(compare_left), std::move(compare_right))
+	{
+	}
+
+	// Copies the pairs in left order and links them in the order of each
+	// side, so that equivalent keys keep their order on both sides.
+	multi_bimap(const multi_bimap& other) : base(other)
+	{
+		std::vector< data_t* > by_left;
+		try
+		{
+			std::vector< std::pair< const data_t*, data_t* > > copy_of;
+			std::vector< data_t* > by_right;
+			by_left.reserve(other.size());
+			by_right.reserve(other.size());
+			copy_of.reserve(other.size());
+			m_pool.reserve(other.size());
+			for (left_iterator it = other.begin_left(); it != other.end_left(); ++it)
+			{
+				by_left.push_back(m_pool.create(*it, *it.flip()));
+				copy_of.emplace_back(node_of_left(it.value), by_left.back());
+			}
+			auto by_source = [](const std::pair< const data_t*, data_t* >& a, const std::pair< const data_t*, data_t* >& b)
+			{ return std::less< const data_t* >()(a.first, b.first); };
+			std::sort(copy_of.begin(), copy_of.end(), by_source);
+			for (right_iterator it = other.begin_right(); it != other.end_right(); ++it)
+			{
+				std::pair< const data_t*, data_t* > source(node_of_right(it.value), nullptr);
+				by_right.push_back(std::lower_bound(copy_of.begin(), copy_of.end(), source, by_source)->second);
+			}
+			base::link_sorted(by_left, by_right);
+		} catch (...)
+		{
+			for (data_t* node : by_left)
+			{
+				m_pool.destroy(node);
+			}
+			throw;
+		}
+	}
+
+	multi_bimap(multi_bimap&& other) noexcept : base(std::move(other)) {}
+
+	multi_bimap& operator=(const multi_bimap& other)
+	{
+		if (this != std::addressof(other))
+		{
+			multi_bimap(other).swap(*this);
+		}
+		return *this;
+	}
+
+	multi_bimap& operator=(multi_bimap&& other) noexcept
+	{
+		if (this != std::addressof(other))
+		{
+			multi_bimap(std::move(other)).swap(*this);
+		}
+		return *this;
+	}
+
+	// Invalidates all iterators referencing elements of this multi_bimap.
+	~multi_bimap() { clear(); }
+
+	// Insert a pair (left, right), returns an iterator to left.
+	// If exactly this pair already exists, no insertion occurs and
+	// end_left() is returned.
+	left_iterator insert(const left_t& left, const right_t& right) { return insert_impl(left, right); }
+
+	left_iterator insert(const left_t& left, right_t&& right) { return insert_impl(left, std::move(right)); }
+
+	left_iterator insert(left_t&& left, const right_t& right) { return insert_impl(std::move(left), right); }
+
+	left_iterator insert(left_t&& left, right_t&& right) { return insert_impl(std::move(left), std::move(right)); }
+
+	// Removes an element and its pair, returns an iterator to the next one.
+	left_iterator erase_left(left_iterator it) noexcept
+	{
+		left_iterator res(std::next(it));
+		erase_impl(it.value, it.flip().value);
+		return res;
+	}
+
+	right_iterator erase_right(right_iterator it) noexcept
+	{
+		right_iterator res(std::next(it));
+		erase_impl(it.flip().value, it.value);
+		return res;
+	}
+
+	// Removes all pairs with the given key, returns their number.
+	std::size_t erase_left(const left_t& left) noexcept
+	{
+		std::size_t count = 0;
+		auto [first, last] = equal_range_left(left);
+		for (left_iterator it(first); it != last; it = erase_left(it))
+		{
+			count++;
+		}
+		return count;
+	}
+
+	std::size_t erase_right(const right_t& right) noexcept
+	{
+		std::size_t count = 0;
+		auto [first, last] = equal_range_right(right);
+		for (right_iterator it(first); it != last; it = erase_right(it))
+		{
+			count++;
+		}
+		return count;
+	}
+
+	// Returns an iterator to some element with the key. If not found, the
+	// corresponding end().
+	left_iterator find_left(const left_t& left) const noexcept
+	{
+		base_t* found = m_left_tree.find(left);
+		return (found ? left_iterator(found) : end_left());
+	}
+
+	right_iterator find_right(const right_t& right) const noexcept
+	{
+		base_t* found = m_right_tree.find(right);
+		return (found ? right_iterator(found) : end_right());
+	}
+
+	// Whether exactly this pair is present. Walks both key ranges together,
+	// so the cost is bounded by the shorter of them.
+	bool contains(const left_t& left, const right_t& right) const noexcept
+	{
+		auto [first_left, last_left] = equal_range_left(left);
+		auto [first_right, last_right] = equal_range_right(right);
+		for (; first_left != last_left && first_right != last_right; ++first_left, ++first_right)
+		{
+			if (m_right_tree.is_equals(*first_left.flip(), right) || m_left_tree.is_equals(*first_right.flip(), left))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// All elements with the key, in the order of their insertion. Both
+	// bounds are found in a single descent.
+	left_range equal_range_left(const left_t& left) const noexcept
+	{
+		base_t* first;
+		base_t* last;
+		m_left_tree.bounds(left, left, first, last);
+		return left_range(left_iterator(first), left_iterator(last));
+	}
+
+	right_range equal_range_right(const right_t& right) const noexcept
+	{
+		base_t* first;
+		base_t* last;
+		m_right_tree.bounds(right, right, first, last);
+		return right_range(right_iterator(first), right_iterator(last));
+	}
+
+	// Number of elements with the key, logarithmic plus linear in the count.
+	std::size_t count_left(const left_t& left) const noexcept
+	{
+		auto [first, last] = equal_range_left(left);
+		return static_cast< std::size_t >(std::distance(first, last));
+	}
+
+	std::size_t count_right(const right_t& right) const noexcept
+	{
+		auto [first, last] = equal_range_right(right);
+		return static_cast< std::size_t >(std::distance(first, last));
+	}
+
+	// lower and upper bounds on each side, see std::multimap.
+	left_iterator lower_bound_left(const left_t& left) const noexcept { return equal_range_left(left).first; }
+
+	left_iterator upper_bound_left(const left_t& left) const noexcept { return equal_range_left(left).second; }
+
+	right_iterator lower_bound_right(const right_t& right) const noexcept
+	{
+		return equal_range_right(right).first;
+	}
+
+	right_iterator upper_bound_right(const right_t& right) const noexcept
+	{
+		return equal_range_right(right).second;
+	}
+
+	// Checks both trees, that every pair is reachable from both sides and
+	// that the size matches the pairs. Linear-logarithmic and does not
+	// splay, meant for debugging and randomized testing.
+	bool check_invariants() const noexcept { return base::check_links(false); }
+};
@@ -0,0 +1,473 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bimap_details
+{
+	// An immutable AVL tree of shared pairs, ordered by one side of the pair.
+	// A change copies the path from the root to the changed node and shares
+	// every other node with the previous version. Nodes are reference
+	// counted, so a version is reclaimed when its last owner goes away.
+	// Lookups do not modify the tree, unlike the splay trees of bimap.
+	template< typename Pair, bool Tree, typename Compare >
+	struct persistent_tree
+	{
+	  public:
+		using key_t = std::conditional_t< Tree, typename Pair::first_type, typename Pair::second_type >;
+
+		struct node
+		{
+			std::shared_ptr< const Pair > pair;
+			std::shared_ptr< const node > left;
+			std::shared_ptr< const node > right;
+			std::size_t height;
+
+			const key_t& key() const noexcept { return key_of(*pair); }
+		};
+
+		using link = std::shared_ptr< const node >;
+
+		// Walks a version in key order. Keeps the path from the root, so it
+		// stays valid only while the nodes on it are owned by some version.
+		struct iterator
+		{
+		  public:
+			using iterator_category = std::bidirectional_iterator_tag;
+			using value_type = Pair;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const value_type*;
+			using reference = const value_type&;
+
+		  private:
+			std::vector< const node* > m_path;
+			const node* m_root = nullptr;
+
+			friend struct persistent_tree;
+
+			explicit iterator(const node* root) : m_root(root) {}
+
+			void descend(const node* from, bool leftmost)
+			{
+				for (; from; from = (leftmost ? from->left : from->right).get())
+				{
+					m_path.push_back(from);
+				}
+			}
+
+			// Goes up while coming from the given side, then once more.
+			void ascend(bool from_right) noexcept
+			{
+				const node* child = m_path.back();
+				m_path.pop_back();
+				while (!m_path.empty() && (from_right ? m_path.back()->right : m_path.back()->left).get() == child)
+				{
+					child = m_path.back();
+					m_path.pop_back();
+				}
+			}
+
+		  public:
+			iterator() noexcept = default;
+
+			reference operator*() const noexcept { return *m_path.back()->pair; }
+
+			pointer operator->() const noexcept { return m_path.back()->pair.get(); }
+
+			// The increment of end() is undefined.
+			iterator& operator++()
+			{
+				const node* top = m_path.back();
+				if (top->right)
+				{
+					descend(top->right.get(), true);
+				}
+				else
+				{
+					ascend(true);
+				}
+				return *this;
+			}
+
+			iterator operator++(int)
+			{
+				iterator res(*this);
+				++(*this);
+				return res;
+			}
+
+			// The decrement of begin() is undefined.
+			iterator& operator--()
+			{
+				if (m_path.empty())
+				{
+					descend(m_root, false);
+				}
+				else if (m_path.back()->left)
+				{
+					descend(m_path.back()->left.get(), false);
+				}
+				else
+				{
+					ascend(false);
+				}
+				return *this;
+			}
+
+			iterator operator--(int)
+			{
+				iterator res(*this);
+				--(*this);
+				return res;
+			}
+
+			bool operator==(const iterator& other) const noexcept
+			{
+				return (m_path.empty() ? other.m_path.empty() : !other.m_path.empty() && m_path.back() == other.m_path.back());
+			}
+
+			bool operator!=(const iterator& other) const noexcept { return !(*this == other); }
+		};
+
+	  private:
+		link m_root;
+		Compare m_compare;
+
+		static const key_t& key_of(const Pair& pair) noexcept
+		{
+			if constexpr (Tree)
+			{
+				return pair.first;
+			}
+			else
+			{
+				return pair.second;
+			}
+		}
+
+		static std::size_t height(const link& n) noexcept { return (n ? n->height : 0); }
+
+		static link make(std::shared_ptr< const Pair > pair, link left, link right)
+		{
+			std::size_t h = 1 + std::max(height(left), height(right));
+			return std::make_shared< const node >(node{ std::move(pair), std::move(left), std::move(right), h });
+		}
+
+		// Makes a node over subtrees whose heights differ by at most two,
+		// rotating once or twice to restore the AVL balance.
+		static link balance(const std::shared_ptr< const Pair >& pair, const link& left, const link& right)
+		{
+			if (height(left) > height(right) + 1)
+			{
+				if (height(left->left) >= height(left->right))
+				{
+					return make(left->pair, left->left, make(pair, left->right, right));
+				}
+				const link& middle = left->right;
+				return make(middle->pair, make(left->pair, left->left, middle->left), make(pair, middle->right, right));
+			}
+			if (height(right) > height(left) + 1)
+			{
+				if (height(right->right) >= height(right->left))
+				{
+					return make(right->pair, make(pair, left, right->left), right->right);
+				}
+				const link& middle = right->left;
+				return make(middle->pair, make(pair, left, middle->left), make(right->pair, middle->right, right->right));
+			}
+			return make(pair, left, right);
+		}
+
+		link insert(const link& n, const std::shared_ptr< const Pair >& pair) const
+		{
+			if (!n)
+			{
+				return make(pair, nullptr, nullptr);
+			}
+			if (m_compare(key_of(*pair), n->key()))
+			{
+				return balance(n->pair, insert(n->left, pair), n->right);
+			}
+			return balance(n->pair, n->left, insert(n->right, pair));
+		}
+
+		static link erase_min(const link& n)
+		{
+			if (!n->left)
+			{
+				return n->right;
+			}
+			return balance(n->pair, erase_min(n->left), n->right);
+		}
+
+		// The key must be present.
+		link erase(const link& n, const key_t& key) const
+		{
+			if (m_compare(key, n->key()))
+			{
+				return balance(n->pair, erase(n->left, key), n->right);
+			}
+			if (m_compare(n->key(), key))
+			{
+				return balance(n->pair, n->left, erase(n->right, key));
+			}
+			if (!n->left || !n->right)
+			{
+				return (n->left ? n->left : n->right);
+			}
+			const node* successor = n->right.get();
+			while (successor->left)
+			{
+				successor = successor->left.get();
+			}
+			return balance(successor->pair, n->left, erase_min(n->right));
+		}
+
+	  public:
+		explicit persistent_tree(Compare compare) : m_compare(std::move(compare)) {}
+
+		// The pair with the key, or nullptr.
+		const Pair* find(const key_t& key) const noexcept
+		{
+			const node* n = m_root.get();
+			while (n)
+			{
+				if (m_compare(key, n->key()))
+				{
+					n = n->left.get();
+				}
+				else if (m_compare(n->key(), key))
+				{
+					n = n->right.get();
+				}
+				else
+				{
+					return n->pair.get();
+				}
+			}
+			return nullptr;
+		}
+
+		iterator find_iterator(const key_t& key) const
+		{
+			iterator res(m_root.get());
+			const node* n = m_root.get();
+			while (n)
+			{
+				res.m_path.push_back(n);
+				if (m_compare(key, n->key()))
+				{
+					n = n->left.get();
+				}
+				else if (m_compare(n->key(), key))
+				{
+					n = n->right.get();
+				}
+				else
+				{
+					return res;
+				}
+			}
+			res.m_path.clear();
+			return res;
+		}
+
+		// The key of pair must be absent.
+		void insert(const std::shared_ptr< const Pair >& pair) { m_root = insert(m_root, pair); }
+
+		// The key must be present.
+		void erase(const key_t& key) { m_root = erase(m_root, key); }
+
+		void clear() noexcept { m_root.reset(); }
+
+		iterator begin() const
+		{
+			iterator res(m_root.get());
+			res.descend(m_root.get(), true);
+			return res;
+		}
+
+		iterator end() const noexcept { return iterator(m_root.get()); }
+
+		const Compare& get_comparator() const noexcept { return m_compare; }
+
+		void swap(persistent_tree& other) noexcept
+		{
+			using std::swap;
+			m_root.swap(other.m_root);
+			swap(m_compare, other.m_compare);
+		}
+	};
+}	 // namespace bimap_details
+
+// A bimap with value semantics in which copies share structure. Copying,
+// and so snapshot(), is O(1); a change costs O(log n) new nodes per side
+// and never affects other copies. Pairs are stored once and shared by both
+// trees, which are balanced AVL trees so that lookups do not write.
+//
+// Different copies may be used from different threads without locking,
+// including copies that share nodes. A single copy is not thread safe:
+// taking a snapshot of it must not race with its modification.
+template< typename Left,
+		  typename Right,
+		  typename CompareLeft = std::less< Left >,
+		  typename CompareRight = std::less< Right > >
+struct persistent_bimap
+{
+  public:
+	using left_t = Left;
+	using right_t = Right;
+	using value_type = std::pair< left_t, right_t >;
+
+  private:
+	using left_tree_t = bimap_details::persistent_tree< value_type, true, CompareLeft >;
+	using right_tree_t = bimap_details::persistent_tree< value_type, false, CompareRight >;
+
+	std::size_t m_count;
+	left_tree_t m_left_tree;
+	right_tree_t m_right_tree;
+
+	template< typename left_t_f, typename right_t_f >
+	bool insert_impl(left_t_f&& left, right_t_f&& right)
+	{
+		if (m_left_tree.find(left) || m_right_tree.find(right))
+		{
+			return false;
+		}
+		auto pair = std::make_shared< const value_type >(std::forward< left_t_f >(left), std::forward< right_t_f >(right));
+		// Both new roots are built before either is replaced.
+		left_tree_t left_tree(m_left_tree);
+		left_tree.insert(pair);
+		m_right_tree.insert(pair);
+		m_left_tree.swap(left_tree);
+		m_count++;
+		return true;
+	}
+
+	void erase_impl(const value_type& pair)
+	{
+		right_tree_t right_tree(m_right_tree);
+		right_tree.erase(pair.second);
+		m_left_tree.erase(pair.first);
+		m_right_tree.swap(right_tree);
+		m_count--;
+	}
+
+  public:
+	// Iterators over the pairs ordered by one side. They stay valid until
+	// this persistent_bimap is changed or destroyed; iterate a snapshot to
+	// keep them valid regardless.
+	using left_iterator = typename left_tree_t::iterator;
+	using right_iterator = typename right_tree_t::iterator;
+
+	// Creates a persistent_bimap that does not contain any pairs.
+	persistent_bimap(CompareLeft compare_left = CompareLeft(), CompareRight compare_right = CompareRight()) :
+		m_count(0), m_left_tree(std::move(compare_left)), m_right_tree(std::move(compare_right))
+	{
+	}
+
+	void swap(persistent_bimap& other) noexcept
+	{
+		std::swap(m_count, other.m_count);
+		m_left_tree.swap(other.m_left_tree);
+		m_right_tree.swap(other.m_right_tree);
+	}
+
+	// An immutable view of the current version, O(1). It is kept alive by
+	// the returned object alone and is not affected by later changes.
+	persistent_bimap snapshot() const { return *this; }
+
+	// Insert a pair (left, right) into a new version.
+	// If such left or such right already exists, nothing changes and false
+	// is returned. If an allocation throws, nothing changes either.
+	bool insert(const left_t& left, const right_t& right) { return insert_impl(left, right); }
+
+	bool insert(const left_t& left, right_t&& right) { return insert_impl(left, std::move(right)); }
+
+	bool insert(left_t&& left, const right_t& right) { return insert_impl(std::move(left), right); }
+
+	bool insert(left_t&& left, right_t&& right) { return insert_impl(std::move(left), std::move(right)); }
+
+	// Removes the pair with the key if present, returns whether it was.
+	bool erase_left(const left_t& left)
+	{
+		const value_type* found = m_left_tree.find(left);
+		if (!found)
+		{
+			return false;
+		}
+		erase_impl(*found);
+		return true;
+	}
+
+	bool erase_right(const right_t& right)
+	{
+		const value_type* found = m_right_tree.find(right);
+		if (!found)
+		{
+			return false;
+		}
+		erase_impl(*found);
+		return true;
+	}
+
+	// Returns an iterator to the pair with the key. If not found, the
+	// corresponding end().
+	left_iterator find_left(const left_t& left) const { return m_left_tree.find_iterator(left); }
+
+	right_iterator find_right(const right_t& right) const { return m_right_tree.find_iterator(right); }
+
+	// Returns the opposite element by element.
+	// If the element does not exist, throws std::out_of_range.
+	const right_t& at_left(const left_t& key) const
+	{
+		const value_type* found = m_left_tree.find(key);
+		if (!found)
+		{
+			throw std::out_of_range("No such element was found!");
+		}
+		return found->second;
+	}
+
+	const left_t& at_right(const right_t& key) const
+	{
+		const value_type* found = m_right_tree.find(key);
+		if (!found)
+		{
+			throw std::out_of_range("No such element was found!");
+		}
+		return found->first;
+	}
+
+	bool contains_left(const left_t& left) const noexcept { return m_left_tree.find(left) != nullptr; }
+
+	bool contains_right(const right_t& right) const noexcept { return m_right_tree.find(right) != nullptr; }
+
+	left_iterator begin_left() const { return m_left_tree.begin(); }
+
+	left_iterator end_left() const noexcept { return m_left_tree.end(); }
+
+	right_iterator begin_right() const { return m_right_tree.begin(); }
+
+	right_iterator end_right() const noexcept { return m_right_tree.end(); }
+
+	// Removes all pairs from this version.
+	void clear() noexcept
+	{
+		m_left_tree.clear();
+		m_right_tree.clear();
+		m_count = 0;
+	}
+
+	bool empty() const noexcept { return !m_count; }
+
+	// Returns the number of pairs.
+	std::size_t size() const noexcept { return m_count; }
+};
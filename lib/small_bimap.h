@@ -0,0 +1,544 @@
+#pragma once
+
+#include "bimap.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// A bimap that keeps up to N pairs inline, without any allocation, and
+// moves them into a regular bimap once the (N + 1)-th pair is inserted.
+// It stays a bimap from then on, clear it by assigning an empty one.
+// Inline pairs stay in their slots, each side keeps slot numbers in its
+// order, so lookups are binary searches over at most N positions.
+// Iterators to inline pairs are positions, so insertion and erasure
+// invalidate them, and switching to the tree invalidates all iterators.
+template< typename Left,
+		  typename Right,
+		  std::size_t N,
+		  typename CompareLeft = std::less< Left >,
+		  typename CompareRight = std::less< Right > >
+struct small_bimap
+{
+	static_assert(N > 0, "small_bimap needs room for at least one inline pair");
+
+  public:
+	using left_t = Left;
+	using right_t = Right;
+	using tree_t = bimap< Left, Right, CompareLeft, CompareRight >;
+
+  private:
+	template< bool Tree >
+	struct base_iterator;
+
+  public:
+	using left_iterator = base_iterator< true >;
+	using right_iterator = base_iterator< false >;
+
+  private:
+	using pair_t = std::pair< left_t, right_t >;
+
+	struct slot
+	{
+		alignas(pair_t) unsigned char storage[sizeof(pair_t)];
+	};
+
+	template< bool Tree >
+	struct base_iterator
+	{
+	  public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = std::conditional_t< Tree, Left, Right >;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type*;
+		using reference = const value_type&;
+
+	  private:
+		using tree_iterator = std::conditional_t< Tree, typename tree_t::left_iterator, typename tree_t::right_iterator >;
+
+		const small_bimap* m_owner = nullptr;
+		std::size_t m_position = 0;
+		tree_iterator m_tree;
+
+		friend struct small_bimap;
+		friend struct base_iterator< !Tree >;
+
+		base_iterator(const small_bimap* owner, std::size_t position) noexcept : m_owner(owner), m_position(position) {}
+
+		base_iterator(const small_bimap* owner, tree_iterator it) noexcept : m_owner(owner), m_tree(it) {}
+
+	  public:
+		base_iterator() noexcept = default;
+
+		const value_type& operator*() const noexcept
+		{
+			if (m_owner->m_tree)
+			{
+				return *m_tree;
+			}
+			if constexpr (Tree)
+			{
+				return m_owner->pair_at(m_owner->m_by_left[m_position]).first;
+			}
+			else
+			{
+				return m_owner->pair_at(m_owner->m_by_right[m_position]).second;
+			}
+		}
+
+		const value_type* operator->() const noexcept { return std::addressof(**this); }
+
+		base_iterator& operator++() noexcept
+		{
+			if (m_owner->m_tree)
+			{
+				++m_tree;
+			}
+			else
+			{
+				++m_position;
+			}
+			return *this;
+		}
+
+		base_iterator operator++(int) noexcept
+		{
+			base_iterator res(*this);
+			++(*this);
+			return res;
+		}
+
+		base_iterator& operator--() noexcept
+		{
+			if (m_owner->m_tree)
+			{
+				--m_tree;
+			}
+			else
+			{
+				--m_position;
+			}
+			return *this;
+		}
+
+		base_iterator operator--(int) noexcept
+		{
+			base_iterator res(*this);
+			--(*this);
+			return res;
+		}
+
+		// Iterator to the other element of the same pair, see bimap.
+		base_iterator< !Tree > flip() const noexcept
+		{
+			if (m_owner->m_tree)
+			{
+				return base_iterator< !Tree >(m_owner, m_tree.flip());
+			}
+			if (m_position == m_owner->m_count)
+			{
+				return base_iterator< !Tree >(m_owner, m_position);
+			}
+			const std::size_t* from = (Tree ? m_owner->m_by_left : m_owner->m_by_right);
+			const std::size_t* to = (Tree ? m_owner->m_by_right : m_owner->m_by_left);
+			return base_iterator< !Tree >(m_owner, std::find(to, to + m_owner->m_count, from[m_position]) - to);
+		}
+
+		bool operator==(const base_iterator& other) const noexcept
+		{
+			return m_position == other.m_position && m_tree == other.m_tree;
+		}
+
+		bool operator!=(const base_iterator& other) const noexcept { return !(*this == other); }
+	};
+
+	std::size_t m_count = 0;
+	slot m_slots[N];
+	bool m_used[N] = {};
+	std::size_t m_by_left[N] = {};
+	std::size_t m_by_right[N] = {};
+	CompareLeft m_compare_left;
+	CompareRight m_compare_right;
+	std::unique_ptr< tree_t > m_tree;
+
+	pair_t& pair_at(std::size_t index) noexcept
+	{
+		return *std::launder(reinterpret_cast< pair_t* >(m_slots[index].storage));
+	}
+
+	const pair_t& pair_at(std::size_t index) const noexcept
+	{
+		return *std::launder(reinterpret_cast< const pair_t* >(m_slots[index].storage));
+	}
+
+	// First position in the order of a side whose element is not less than key.
+	std::size_t lower_left(const left_t& key) const noexcept
+	{
+		return std::partition_point(m_by_left, m_by_left + m_count,
+									[&](std::size_t index) { return m_compare_left(pair_at(index).first, key); }) -
+			   m_by_left;
+	}
+
+	std::size_t lower_right(const right_t& key) const noexcept
+	{
+		return std::partition_point(m_by_right, m_by_right + m_count,
+									[&](std::size_t index) { return m_compare_right(pair_at(index).second, key); }) -
+			   m_by_right;
+	}
+
+	std::size_t upper_left(const left_t& key) const noexcept
+	{
+		return std::partition_point(m_by_left, m_by_left + m_count,
+									[&](std::size_t index) { return !m_compare_left(key, pair_at(index).first); }) -
+			   m_by_left;
+	}
+
+	std::size_t upper_right(const right_t& key) const noexcept
+	{
+		return std::partition_point(m_by_right, m_by_right + m_count,
+									[&](std::size_t index) { return !m_compare_right(key, pair_at(index).second); }) -
+			   m_by_right;
+	}
+
+	std::size_t find_left_position(const left_t& key) const noexcept
+	{
+		std::size_t position = lower_left(key);
+		return (position != m_count && !m_compare_left(key, pair_at(m_by_left[position]).first) ? position : m_count);
+	}
+
+	std::size_t find_right_position(const right_t& key) const noexcept
+	{
+		std::size_t position = lower_right(key);
+		return (position != m_count && !m_compare_right(key, pair_at(m_by_right[position]).second) ? position : m_count);
+	}
+
+	static void insert_at(std::size_t* order, std::size_t count, std::size_t position, std::size_t index) noexcept
+	{
+		std::copy_backward(order + position, order + count, order + count + 1);
+		order[position] = index;
+	}
+
+	static void remove_at(std::size_t* order, std::size_t count, std::size_t position) noexcept
+	{
+		std::copy(order + position + 1, order + count, order + position);
+	}
+
+	// Moves inline pairs into a newly created tree. Nodes for them and for
+	// the pair being inserted are allocated first, so nothing is moved out
+	// of the slots unless the whole spill succeeds; pairs are moved only if
+	// that cannot throw.
+	void spill()
+	{
+		std::unique_ptr< tree_t > tree(new tree_t(m_compare_left, m_compare_right));
+		tree->reserve(m_count + 1);
+		for (std::size_t i = 0; i < m_count; i++)
+		{
+			pair_t& p = pair_at(m_by_left[i]);
+			tree->insert(std::move_if_noexcept(p.first), std::move_if_noexcept(p.second));
+		}
+		destroy_inline();
+		m_tree = std::move(tree);
+	}
+
+	// Takes the pairs of other, which is left empty. This must be empty.
+	void take(small_bimap& other) noexcept(std::is_nothrow_move_constructible_v< pair_t >)
+	{
+		m_tree = std::move(other.m_tree);
+		for (std::size_t i = 0; i < N; i++)
+		{
+			if (other.m_used[i])
+			{
+				::new (static_cast< void* >(m_slots[i].storage)) pair_t(std::move(other.pair_at(i)));
+				m_used[i] = true;
+			}
+		}
+		std::copy(other.m_by_left, other.m_by_left + other.m_count, m_by_left);
+		std::copy(other.m_by_right, other.m_by_right + other.m_count, m_by_right);
+		m_count = other.m_count;
+		other.destroy_inline();
+	}
+
+	void destroy_inline() noexcept
+	{
+		for (std::size_t i = 0; i < N; i++)
+		{
+			if (m_used[i])
+			{
+				pair_at(i).~pair_t();
+				m_used[i] = false;
+			}
+		}
+		m_count = 0;
+	}
+
+	template< typename left_t_f = left_t, typename right_t_f = right_t >
+	left_iterator insert_impl(left_t_f&& left, right_t_f&& right)
+	{
+		if (!m_tree)
+		{
+			std::size_t left_position = lower_left(left);
+			std::size_t right_position = lower_right(right);
+			if ((left_position != m_count && !m_compare_left(left, pair_at(m_by_left[left_position]).first)) ||
+				(right_position != m_count && !m_compare_right(right, pair_at(m_by_right[right_position]).second)))
+			{
+				return end_left();
+			}
+			if (m_count < N)
+			{
+				std::size_t index = std::find(m_used, m_used + N, false) - m_used;
+				::new (static_cast< void* >(m_slots[index].storage))
+					pair_t(std::forward< left_t_f >(left), std::forward< right_t_f >(right));
+				m_used[index] = true;
+				insert_at(m_by_left, m_count, left_position, index);
+				insert_at(m_by_right, m_count, right_position, index);
+				m_count++;
+				return left_iterator(this, left_position);
+			}
+			spill();
+		}
+		return left_iterator(this, m_tree->insert(std::forward< left_t_f >(left), std::forward< right_t_f >(right)));
+	}
+
+	void erase_inline(std::size_t left_position, std::size_t right_position) noexcept
+	{
+		std::size_t index = m_by_left[left_position];
+		remove_at(m_by_left, m_count, left_position);
+		remove_at(m_by_right, m_count, right_position);
+		pair_at(index).~pair_t();
+		m_used[index] = false;
+		m_count--;
+	}
+
+  public:
+	small_bimap(CompareLeft compare_left = CompareLeft(), CompareRight compare_right = CompareRight()) :
+		m_compare_left(std::move(compare_left)), m_compare_right(std::move(compare_right))
+	{
+	}
+
+	small_bimap(const small_bimap& other) : m_compare_left(other.m_compare_left), m_compare_right(other.m_compare_right)
+	{
+		if (other.m_tree)
+		{
+			m_tree.reset(new tree_t(*other.m_tree));
+			return;
+		}
+		try
+		{
+			for (left_iterator it = other.begin_left(); it != other.end_left(); it++)
+			{
+				insert(*it, *(it.flip()));
+			}
+		} catch (...)
+		{
+			destroy_inline();
+			throw;
+		}
+	}
+
+	small_bimap& operator=(const small_bimap& other)
+	{
+		if (this != std::addressof(other))
+		{
+			*this = small_bimap(other);
+		}
+		return *this;
+	}
+
+	// Inline pairs are moved one by one, so unlike bimap this is linear in
+	// the number of inline pairs.
+	small_bimap(small_bimap&& other) noexcept(std::is_nothrow_move_constructible_v< pair_t >) :
+		m_compare_left(other.m_compare_left), m_compare_right(other.m_compare_right)
+	{
+		take(other);
+	}
+
+	small_bimap& operator=(small_bimap&& other) noexcept(std::is_nothrow_move_constructible_v< pair_t >)
+	{
+		if (this != std::addressof(other))
+		{
+			destroy_inline();
+			m_compare_left = other.m_compare_left;
+			m_compare_right = other.m_compare_right;
+			take(other);
+		}
+		return *this;
+	}
+
+	void swap(small_bimap& other) noexcept(std::is_nothrow_move_constructible_v< pair_t >)
+	{
+		small_bimap tmp(std::move(other));
+		other = std::move(*this);
+		*this = std::move(tmp);
+	}
+
+	~small_bimap() { destroy_inline(); }
+
+	// Insert a pair (left, right), returns an iterator to left.
+	// If such left or such right already exists, no insertion occurs and
+	// end_left() is returned.
+	left_iterator insert(const left_t& left, const right_t& right) { return insert_impl(left, right); }
+
+	left_iterator insert(const left_t& left, right_t&& right) { return insert_impl(left, std::move(right)); }
+
+	left_iterator insert(left_t&& left, const right_t& right) { return insert_impl(std::move(left), right); }
+
+	left_iterator insert(left_t&& left, right_t&& right) { return insert_impl(std::move(left), std::move(right)); }
+
+	// Removes an element and its pair, returns an iterator to the next one.
+	left_iterator erase_left(left_iterator it) noexcept
+	{
+		if (m_tree)
+		{
+			return left_iterator(this, m_tree->erase_left(it.m_tree));
+		}
+		erase_inline(it.m_position, it.flip().m_position);
+		return it;
+	}
+
+	right_iterator erase_right(right_iterator it) noexcept
+	{
+		if (m_tree)
+		{
+			return right_iterator(this, m_tree->erase_right(it.m_tree));
+		}
+		erase_inline(it.flip().m_position, it.m_position);
+		return it;
+	}
+
+	// Removes the element by key if it is present. Returns whether the pair
+	// was deleted.
+	bool erase_left(const left_t& left) noexcept
+	{
+		left_iterator found = find_left(left);
+		if (found == end_left())
+		{
+			return false;
+		}
+		erase_left(found);
+		return true;
+	}
+
+	bool erase_right(const right_t& right) noexcept
+	{
+		right_iterator found = find_right(right);
+		if (found == end_right())
+		{
+			return false;
+		}
+		erase_right(found);
+		return true;
+	}
+
+	// Returns an iterator over the element. If not found, the corresponding end().
+	left_iterator find_left(const left_t& left) const noexcept
+	{
+		if (m_tree)
+		{
+			return left_iterator(this, m_tree->find_left(left));
+		}
+		return left_iterator(this, find_left_position(left));
+	}
+
+	right_iterator find_right(const right_t& right) const noexcept
+	{
+		if (m_tree)
+		{
+			return right_iterator(this, m_tree->find_right(right));
+		}
+		return right_iterator(this, find_right_position(right));
+	}
+
+	// Returns the opposite element by element.
+	// If the element does not exist, throws std::out_of_range.
+	const right_t& at_left(const left_t& key) const
+	{
+		left_iterator found = find_left(key);
+		if (found == end_left())
+		{
+			throw std::out_of_range("No such element was found!");
+		}
+		return *found.flip();
+	}
+
+	const left_t& at_right(const right_t& key) const
+	{
+		right_iterator found = find_right(key);
+		if (found == end_right())
+		{
+			throw std::out_of_range("No such element was found!");
+		}
+		return *found.flip();
+	}
+
+	// lower and upper bounds on each side, see bimap.
+	left_iterator lower_bound_left(const left_t& left) const noexcept
+	{
+		return (m_tree ? left_iterator(this, m_tree->lower_bound_left(left)) : left_iterator(this, lower_left(left)));
+	}
+
+	left_iterator upper_bound_left(const left_t& left) const noexcept
+	{
+		return (m_tree ? left_iterator(this, m_tree->upper_bound_left(left)) : left_iterator(this, upper_left(left)));
+	}
+
+	right_iterator lower_bound_right(const right_t& right) const noexcept
+	{
+		return (m_tree ? right_iterator(this, m_tree->lower_bound_right(right)) : right_iterator(this, lower_right(right)));
+	}
+
+	right_iterator upper_bound_right(const right_t& right) const noexcept
+	{
+		return (m_tree ? right_iterator(this, m_tree->upper_bound_right(right)) : right_iterator(this, upper_right(right)));
+	}
+
+	left_iterator begin_left() const noexcept
+	{
+		return (m_tree ? left_iterator(this, m_tree->begin_left()) : left_iterator(this, std::size_t(0)));
+	}
+
+	left_iterator end_left() const noexcept
+	{
+		return (m_tree ? left_iterator(this, m_tree->end_left()) : left_iterator(this, m_count));
+	}
+
+	right_iterator begin_right() const noexcept
+	{
+		return (m_tree ? right_iterator(this, m_tree->begin_right()) : right_iterator(this, std::size_t(0)));
+	}
+
+	right_iterator end_right() const noexcept
+	{
+		return (m_tree ? right_iterator(this, m_tree->end_right()) : right_iterator(this, m_count));
+	}
+
+	// Whether the pairs are still stored inline.
+	bool is_inline() const noexcept { return !m_tree; }
+
+	bool empty() const noexcept { return !size(); }
+
+	std::size_t size() const noexcept { return (m_tree ? m_tree->size() : m_count); }
+
+	friend bool operator==(const small_bimap& a, const small_bimap& b) noexcept
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+		for (left_iterator it_a = a.begin_left(), it_b = b.begin_left(); it_a != a.end_left(); it_a++, it_b++)
+		{
+			if (a.m_compare_left(*it_a, *it_b) || a.m_compare_left(*it_b, *it_a) ||
+				a.m_compare_right(*it_a.flip(), *it_b.flip()) || a.m_compare_right(*it_b.flip(), *it_a.flip()))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	friend bool operator!=(const small_bimap& a, const small_bimap& b) noexcept { return !(a == b); }
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+// An immutable bimap of exactly N pairs, built in a constant expression.
+// Both sides are sorted into arrays at construction and looked up by
+// binary search, so lookups never allocate. Left, Right and the
+// comparators must be usable in constant expressions, e.g. integers,
+// enums and std::string_view. Duplicate lefts or rights are an error,
+// which makes a constexpr construction ill-formed.
+template< typename Left,
+		  typename Right,
+		  std::size_t N,
+		  typename CompareLeft = std::less< Left >,
+		  typename CompareRight = std::less< Right > >
+struct static_bimap
+{
+	static_assert(N > 0, "static_bimap needs at least one pair");
+
+  public:
+	using left_t = Left;
+	using right_t = Right;
+	using value_type = std::pair< left_t, right_t >;
+	using const_iterator = const value_type*;
+
+  private:
+	// Pairs ordered by left, and positions of pairs ordered by right.
+	std::array< value_type, N > m_pairs{};
+	std::array< std::size_t, N > m_by_right{};
+	CompareLeft m_compare_left;
+	CompareRight m_compare_right;
+
+	// Insertion sort of positions, std::sort is not constexpr before C++20.
+	template< typename Less >
+	static constexpr void sort(std::array< std::size_t, N >& order, Less less)
+	{
+		for (std::size_t i = 0; i < N; i++)
+		{
+			order[i] = i;
+		}
+		for (std::size_t i = 1; i < N; i++)
+		{
+			for (std::size_t j = i; j > 0 && less(order[j], order[j - 1]); j--)
+			{
+				std::size_t tmp = order[j];
+				order[j] = order[j - 1];
+				order[j - 1] = tmp;
+			}
+		}
+	}
+
+	constexpr std::size_t find_left_index(const left_t& left) const noexcept
+	{
+		std::size_t first = 0;
+		std::size_t last = N;
+		while (first < last)
+		{
+			std::size_t middle = first + (last - first) / 2;
+			if (m_compare_left(m_pairs[middle].first, left))
+			{
+				first = middle + 1;
+			}
+			else
+			{
+				last = middle;
+			}
+		}
+		return (first < N && !m_compare_left(left, m_pairs[first].first) ? first : N);
+	}
+
+	constexpr std::size_t find_right_index(const right_t& right) const noexcept
+	{
+		std::size_t first = 0;
+		std::size_t last = N;
+		while (first < last)
+		{
+			std::size_t middle = first + (last - first) / 2;
+			if (m_compare_right(m_pairs[m_by_right[middle]].second, right))
+			{
+				first = middle + 1;
+			}
+			else
+			{
+				last = middle;
+			}
+		}
+		return (first < N && !m_compare_right(right, m_pairs[m_by_right[first]].second) ? m_by_right[first] : N);
+	}
+
+  public:
+	constexpr static_bimap(const value_type (&pairs)[N],
+						   CompareLeft compare_left = CompareLeft(),
+						   CompareRight compare_right = CompareRight()) :
+		m_compare_left(compare_left), m_compare_right(compare_right)
+	{
+		std::array< std::size_t, N > by_left{};
+		sort(by_left, [&](std::size_t a, std::size_t b) { return m_compare_left(pairs[a].first, pairs[b].first); });
+		for (std::size_t i = 0; i < N; i++)
+		{
+			m_pairs[i].first = pairs[by_left[i]].first;
+			m_pairs[i].second = pairs[by_left[i]].second;
+		}
+		sort(m_by_right, [&](std::size_t a, std::size_t b) { return m_compare_right(m_pairs[a].second, m_pairs[b].second); });
+		for (std::size_t i = 1; i < N; i++)
+		{
+			if (!m_compare_left(m_pairs[i - 1].first, m_pairs[i].first))
+			{
+				throw std::invalid_argument("Duplicate left element!");
+			}
+			if (!m_compare_right(m_pairs[m_by_right[i - 1]].second, m_pairs[m_by_right[i]].second))
+			{
+				throw std::invalid_argument("Duplicate right element!");
+			}
+		}
+	}
+
+	// Returns the opposite element by element.
+	// If the element does not exist, throws std::out_of_range.
+	constexpr const right_t& at_left(const left_t& key) const
+	{
+		std::size_t found = find_left_index(key);
+		if (found == N)
+		{
+			throw std::out_of_range("No such element was found!");
+		}
+		return m_pairs[found].second;
+	}
+
+	constexpr const left_t& at_right(const right_t& key) const
+	{
+		std::size_t found = find_right_index(key);
+		if (found == N)
+		{
+			throw std::out_of_range("No such element was found!");
+		}
+		return m_pairs[found].first;
+	}
+
+	// Returns a pointer to the pair of the element, or end() if not found.
+	constexpr const_iterator find_left(const left_t& key) const noexcept { return begin() + find_left_index(key); }
+
+	constexpr const_iterator find_right(const right_t& key) const noexcept { return begin() + find_right_index(key); }
+
+	constexpr bool contains_left(const left_t& key) const noexcept { return find_left_index(key) != N; }
+
+	constexpr bool contains_right(const right_t& key) const noexcept { return find_right_index(key) != N; }
+
+	// Pairs ordered by left.
+	constexpr const_iterator begin() const noexcept { return m_pairs.data(); }
+
+	constexpr const_iterator end() const noexcept { return m_pairs.data() + N; }
+
+	constexpr bool empty() const noexcept { return !N; }
+
+	constexpr std::size_t size() const noexcept { return N; }
+};
+
+template< typename Left, typename Right, std::size_t N >
+static_bimap(const std::pair< Left, Right > (&)[N]) -> static_bimap< Left, Right, N >;